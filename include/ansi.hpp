@@ -0,0 +1,15 @@
+#ifndef _HEADER_CUI3D_ANSI_HPP_
+#define _HEADER_CUI3D_ANSI_HPP_
+#include <string>
+#include <vector>
+#include "cui3d.hpp"
+
+namespace cui3d {
+
+// escape sequences that bring a terminal showing the previous frame to
+// the next one; clear wipes the terminal first
+std::string to_ansi(const std::vector<CellRun> &, const bool clear = false);
+
+} // namespace cui3d
+
+#endif
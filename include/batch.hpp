@@ -0,0 +1,37 @@
+#ifndef _HEADER_CUI3D_BATCH_HPP_
+#define _HEADER_CUI3D_BATCH_HPP_
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include "cui3d.hpp"
+#include "parallel.hpp"
+#include "status.hpp"
+
+namespace cui3d {
+
+// draws frame number k into a blank height x width image
+using BatchScene = std::function<void(const std::size_t k, CuiImage &)>;
+using BatchSink = std::function<void(const std::size_t k, const CuiImage &)>;
+
+// Offline rendering: every worker renders whole frames on its own, with
+// its own images and row loops kept on its thread, so throughput grows
+// with the number of cores. sink sees the frames in order, on the
+// calling thread. At most 2 * workers frames are held at a time.
+void render_batch(const std::size_t frames, const std::size_t height,
+    const std::size_t width, const BatchScene &, const BatchSink &,
+    const std::size_t workers = worker_count());
+// as a recording (see recorder.hpp), frame k stamped k * period
+status_t render_batch(const std::string &path, const std::size_t frames,
+    const std::size_t height, const std::size_t width,
+    const std::chrono::nanoseconds period, const BatchScene &,
+    const std::size_t workers = worker_count());
+// as one ANSI stream that plays the frames back to back
+status_t render_batch(std::ostream &, const std::size_t frames,
+    const std::size_t height, const std::size_t width, const BatchScene &,
+    const std::size_t workers = worker_count());
+
+} // namespace cui3d
+
+#endif
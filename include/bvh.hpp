@@ -0,0 +1,95 @@
+#ifndef _HEADER_CUI3D_BVH_HPP_
+#define _HEADER_CUI3D_BVH_HPP_
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <boost/optional.hpp>
+#include "geometry.hpp"
+#include "polygon.hpp"
+
+namespace cui3d {
+
+constexpr std::size_t packet_size = 4;
+// deepest tree traverse() can walk, trees read from disk are checked
+constexpr std::size_t bvh_max_depth = 64;
+
+struct RayHit {
+  double t;
+  std::size_t polygon_id;
+  std::size_t triangle_id;
+};
+
+// rays are stored lane by lane so that every step of the intersection
+// tests runs over packet_size doubles at once
+struct RayPacket {
+  template <typename T>
+  using lanes = std::array<T, packet_size>;
+  lanes<double> ox, oy, oz;
+  lanes<double> dx, dy, dz;
+  lanes<double> t_max;
+  std::size_t size;
+  RayPacket() : size(0) {}
+  void push(const Ray &,
+      const double t_max = std::numeric_limits<double>::infinity());
+};
+
+// count == 0: inner node, the left child follows it and offset is the
+// right child. otherwise: leaf of count triangles starting at offset.
+struct BVHNode {
+  double lower[3];
+  double upper[3];
+  std::uint32_t offset;
+  std::uint32_t count;
+};
+
+struct BVHTriangle {
+  double v0[3];
+  double e1[3];
+  double e2[3];
+  std::uint32_t polygon_id;
+  std::uint32_t triangle_id;
+};
+
+class BVH {
+ public:
+  using PacketHits = std::array<boost::optional<RayHit>, packet_size>;
+  BVH() {}
+  explicit BVH(const std::vector<Polygon> &);
+  // borrows the arrays, which must outlive the BVH and be well formed
+  BVH(const BVHNode *nodes, const std::size_t node_count,
+      const BVHTriangle *triangles, const std::size_t triangle_count)
+    : nodes(nodes), node_count(node_count),
+      triangles(triangles), triangle_count(triangle_count) {}
+  BVH(const BVH &);
+  BVH(BVH &&) = default;
+  BVH &operator=(const BVH &);
+  BVH &operator=(BVH &&) = default;
+  boost::optional<RayHit> closest_hit(const Ray &,
+      const double t_max = std::numeric_limits<double>::infinity()) const;
+  bool any_hit(const Ray &,
+      const double t_max = std::numeric_limits<double>::infinity()) const;
+  PacketHits closest_hit(const RayPacket &) const;
+  std::array<bool, packet_size> any_hit(const RayPacket &) const;
+  const BVHNode *get_nodes() const { return nodes; }
+  std::size_t get_node_count() const { return node_count; }
+  const BVHTriangle *get_triangles() const { return triangles; }
+  std::size_t get_triangle_count() const { return triangle_count; }
+ private:
+  template <bool any>
+  void traverse(const RayPacket &, RayPacket::lanes<double> &t,
+      RayPacket::lanes<std::uint32_t> &hit) const;
+  void bind();
+  // empty when borrowed
+  std::vector<BVHNode> owned_nodes;
+  std::vector<BVHTriangle> owned_triangles;
+  const BVHNode *nodes = nullptr;
+  std::size_t node_count = 0;
+  const BVHTriangle *triangles = nullptr;
+  std::size_t triangle_count = 0;
+};
+
+} // namespace cui3d
+
+#endif
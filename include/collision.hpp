@@ -0,0 +1,76 @@
+#ifndef _HEADER_CUI3D_COLLISION_HPP_
+#define _HEADER_CUI3D_COLLISION_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "geometry.hpp"
+#include "polygon.hpp"
+
+namespace cui3d {
+
+struct AABB {
+  Vec3D lower, upper;
+};
+
+AABB aabb(const Triangle &);
+AABB aabb(const std::vector<Triangle> &);
+bool overlap(const AABB &, const AABB &);
+// touching counts as intersecting in all three; polygons are surfaces, one
+// closed mesh wholly inside another does not intersect it
+bool intersect(const AABB &, const Triangle &);
+bool intersect(const Triangle &, const Triangle &);
+bool intersect(const Polygon &, const Polygon &);
+
+// Broad phase over a dynamic AABB tree. Every object is stored with its
+// box grown by margin, so an object that moves by less than that leaves
+// the tree alone. colliding_pairs() confirms the candidate pairs on the
+// triangles, keeping only triangles that touch the overlap of the two
+// boxes.
+class CollisionWorld {
+ public:
+  using Id = std::uint32_t;
+  explicit CollisionWorld(const double margin = 0.05) : margin(margin), root(none) {}
+  // the triangles are copied; ids of removed objects are handed out again
+  Id add(const Polygon &);
+  // false when id is not in the world
+  bool update(const Id, const Polygon &);
+  bool remove(const Id);
+  // pairs (a, b) with a < b whose grown boxes overlap
+  std::vector<std::pair<Id, Id>> candidate_pairs() const;
+  std::vector<std::pair<Id, Id>> colliding_pairs() const;
+  // updates that moved an object out of its grown box and so had to
+  // reinsert it, for judging the margin
+  std::size_t reinsertions() const { return reinserted; }
+ private:
+  static constexpr std::uint32_t none = 0xffffffff;
+  struct Node {
+    AABB box;
+    std::uint32_t parent, left, right;
+    // leaf when left == none
+    Id object;
+  };
+  struct Object {
+    std::vector<Triangle> triangles;
+    AABB box;
+    std::uint32_t leaf;
+  };
+  bool alive(const Id id) const {
+    return id < objects.size() && objects[id].leaf != none;
+  }
+  std::uint32_t allocate();
+  void insert_leaf(const std::uint32_t leaf);
+  void remove_leaf(const std::uint32_t leaf);
+  void refit(std::uint32_t node);
+  double margin;
+  std::uint32_t root;
+  std::vector<Node> nodes;
+  std::vector<std::uint32_t> free_nodes;
+  std::vector<Object> objects;
+  std::vector<Id> free_ids;
+  std::size_t reinserted = 0;
+};
+
+} // namespace cui3d
+
+#endif
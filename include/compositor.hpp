@@ -0,0 +1,79 @@
+#ifndef _HEADER_CUI3D_COMPOSITOR_HPP_
+#define _HEADER_CUI3D_COMPOSITOR_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "cui3d.hpp"
+
+namespace cui3d {
+
+// A rectangle of cells stacked by z, higher on top, and placed at
+// (row, col) on the compositor; it may hang over the edges. Cells are
+// packed into 16 bits and visibility into 64 bit words per row.
+class Layer {
+ public:
+  Layer(const std::size_t height, const std::size_t width, const int z = 0,
+      const long row = 0, const long col = 0);
+  // composites img onto the layer with its top left at (row, col)
+  void draw(const CuiImage &img, const std::size_t row = 0,
+      const std::size_t col = 0);
+  void clear();
+  // drops the content; buffers only grow
+  void resize(const std::size_t height, const std::size_t width);
+  void move(const long row, const long col);
+  void set_z(const int z);
+  void show(const bool shown);
+  std::size_t get_height() const { return height; }
+  std::size_t get_width() const { return width; }
+  long get_row() const { return row; }
+  long get_col() const { return col; }
+  int get_z() const { return z; }
+  bool is_empty() const { return empty; }
+ private:
+  friend class Compositor;
+  std::size_t height, width, words;
+  int z;
+  long row, col;
+  bool shown;
+  bool empty;
+  bool dirty;
+  // where the layer was when last composited
+  long shown_row, shown_col;
+  std::size_t shown_height;
+  bool was_shown;
+  std::vector<std::uint16_t> cells;
+  std::vector<std::uint64_t> mask;
+};
+
+// Keeps the blended image of its layers and on compose() only redoes
+// the rows touched by layers that changed since the last call.
+class Compositor {
+ public:
+  Compositor(const std::size_t height, const std::size_t width);
+  Layer &add_layer(const std::size_t height, const std::size_t width,
+      const int z = 0, const long row = 0, const long col = 0);
+  void remove_layer(const Layer &);
+  const CuiImage &compose();
+  // every row is composed again on the next compose(); buffers only grow
+  void resize(const std::size_t height, const std::size_t width);
+  // whether the last compose() changed anything
+  bool changed() const { return last_changed; }
+  std::size_t get_height() const { return height; }
+  std::size_t get_width() const { return width; }
+ private:
+  void mark(const long row, const std::size_t height);
+  void blend_row(const Layer &, const std::size_t r);
+  std::size_t height, width, words;
+  std::vector<std::unique_ptr<Layer>> layers;
+  std::vector<const Layer *> order;
+  std::vector<std::uint16_t> cells;
+  std::vector<std::uint64_t> mask;
+  std::vector<char> dirty_rows;
+  bool last_changed;
+  CuiImage image;
+};
+
+} // namespace cui3d
+
+#endif
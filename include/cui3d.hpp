@@ -2,6 +2,7 @@
 #define _HEADER_CUI3D_CUI3D_HPP_
 #include "status.hpp"
 #include <cstddef>
+#include <memory>
 #include <vector>
 #include "pixel.hpp"
 
@@ -21,6 +22,9 @@ class CuiImage {
     : height(height), width(width),
       data(data), visible(visible) {};
   void view();
+  // every cell ends up hidden; rows keep their capacity, so a renderer
+  // can resize one image each frame and only allocates when it grows
+  void resize(std::size_t height, std::size_t width);
   std::size_t height, width;
   table<Pixel> data;
   table<bool> visible;
@@ -28,6 +32,24 @@ class CuiImage {
 };
 
 CuiImage &composite(CuiImage &, const CuiImage &);
+// nearest neighbor
+CuiImage upscale(const CuiImage &, std::size_t height, std::size_t width);
+
+// consecutive cells of one row that changed between two frames;
+// cells that are not visible must be cleared
+struct CellRun {
+  std::size_t row, col;
+  std::vector<Pixel> pixels;
+  std::vector<bool> visible;
+};
+
+std::vector<CellRun> diff(const CuiImage &prev, const CuiImage &next);
+CuiImage &apply(CuiImage &, const std::vector<CellRun> &);
+
+class FrameRecorder;
+class Compositor;
+class Layer;
+class WinchSubscription;
 
 class Screen {
  public:
@@ -35,12 +57,29 @@ class Screen {
   ~Screen();
   void draw(const CuiImage &);
   void render();
+  // blanks the terminal; the next render() repaints every visible cell
   void clear();
+  // applies a resize reported by SIGWINCH, true when the size changed;
+  // render() calls it first, call it before sizing a frame to draw
+  bool poll_resize();
   std::size_t get_height() const { return height; }
   std::size_t get_width() const { return width; }
+  // draw() goes to a full screen layer at z 0 that is cleared on every
+  // render; layers added here stay until changed, see compositor.hpp
+  Layer &add_layer(const std::size_t height, const std::size_t width,
+      const int z = 1, const long row = 0, const long col = 0);
+  void remove_layer(const Layer &);
+  // every rendered diff is handed to recorder, nullptr to stop
+  void set_recorder(FrameRecorder *recorder) { this->recorder = recorder; }
  private:
+  void resize(const std::size_t height, const std::size_t width);
+  FrameRecorder *recorder = nullptr;
+  bool repaint = false;
+  std::unique_ptr<WinchSubscription> winch;
+  unsigned long winch_seen;
   CuiImage current_image;
-  CuiImage next_image;
+  std::unique_ptr<Compositor> compositor;
+  Layer *base;
   std::size_t height;
   std::size_t width;
   static bool is_init_scr;
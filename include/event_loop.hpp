@@ -0,0 +1,59 @@
+#ifndef _HEADER_CUI3D_EVENT_LOOP_HPP_
+#define _HEADER_CUI3D_EVENT_LOOP_HPP_
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <termios.h>
+#include "winch.hpp"
+
+namespace cui3d {
+
+struct InputEvent {
+  enum class Type {
+    KEY,
+    RESIZE,
+    CLOSE
+  };
+  Type type;
+  int key;
+};
+
+// Reads the terminal on its own thread so that input never waits for a
+// render. Events are handed over in batches: every key that arrived since
+// the last call, with any number of SIGWINCH folded into one RESIZE.
+class EventLoop {
+ public:
+  using Update = std::function<bool(const std::vector<InputEvent> &)>;
+  using Render = std::function<void()>;
+  explicit EventLoop(const int fd = 0);
+  EventLoop(const EventLoop &) = delete;
+  ~EventLoop();
+  std::vector<InputEvent> poll();
+  std::vector<InputEvent> wait();
+  std::vector<InputEvent> wait(const std::chrono::nanoseconds timeout);
+  // render is called only after update reports a state change
+  void run(const Update &, const Render &);
+  void stop();
+ private:
+  void read_input();
+  void push(const InputEvent &);
+  int fd;
+  int wake_pipe[2];
+  int winch_pipe[2];
+  std::unique_ptr<WinchSubscription> winch;
+  bool restore_termios;
+  termios saved_termios;
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::vector<InputEvent> pending;
+  bool stopped;
+  std::thread reader;
+};
+
+} // namespace cui3d
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef _HEADER_CUI3D_FRAME_CACHE_HPP_
+#define _HEADER_CUI3D_FRAME_CACHE_HPP_
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include "cui3d.hpp"
+#include "polygon.hpp"
+
+namespace cui3d {
+
+// Everything a frame depends on. The scene is summed up by a version the
+// caller bumps whenever it changes; the camera is rounded to 1e-9 so that
+// poses reached again by a different path still match.
+struct FrameKey {
+  std::uint64_t scene_version;
+  std::array<std::int64_t, 6> camera;
+  RenderMode mode;
+  std::size_t height, width;
+  std::uint64_t hash;
+  bool operator==(const FrameKey &rhs) const {
+    return scene_version == rhs.scene_version && camera == rhs.camera
+      && mode == rhs.mode && height == rhs.height && width == rhs.width;
+  }
+};
+
+FrameKey frame_key(const std::uint64_t scene_version, const Camera &,
+    const std::size_t height, const std::size_t width);
+
+// the last capacity distinct frames, least recently used dropped first
+class FrameCache {
+ public:
+  explicit FrameCache(const std::size_t capacity = 16) : capacity(capacity),
+    hit_count(0), miss_count(0) {}
+  // nullptr on a miss
+  const CuiImage *find(const FrameKey &);
+  const CuiImage &insert(const FrameKey &, CuiImage frame);
+  // render() is only called on a miss
+  template <typename F>
+  const CuiImage &get(const FrameKey &key, F render) {
+    if (const CuiImage *img = find(key)) return *img;
+    return insert(key, render());
+  }
+  void clear();
+  std::size_t size() const { return entries.size(); }
+  std::uint64_t hits() const { return hit_count; }
+  std::uint64_t misses() const { return miss_count; }
+ private:
+  struct Entry {
+    FrameKey key;
+    CuiImage frame;
+  };
+  std::size_t capacity;
+  // most recently used first
+  std::list<Entry> entries;
+  std::unordered_map<std::uint64_t, std::list<Entry>::iterator> index;
+  std::uint64_t hit_count, miss_count;
+};
+
+} // namespace cui3d
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef _HEADER_CUI3D_FRAME_LOOP_HPP_
+#define _HEADER_CUI3D_FRAME_LOOP_HPP_
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace cui3d {
+
+// What to do when a frame finishes after the next deadline.
+enum class SkipPolicy {
+  // render the late frames back to back until on schedule again
+  CATCH_UP,
+  // drop the frame slots that already passed, keeping the phase
+  SKIP,
+  // restart the schedule from the late frame
+  RESYNC
+};
+
+struct FrameStats {
+  std::size_t frames;
+  // deadlines that were already over when the frame was done
+  std::size_t missed;
+  // start to start time of the recent frames
+  std::chrono::nanoseconds p50, p99, worst;
+};
+
+// Sleeps to absolute CLOCK_MONOTONIC deadlines so that errors do not add
+// up, and runs the simulation on a fixed timestep decoupled from the
+// frame rate. render gets how far the simulation time lies between the
+// last two updates, in [0, 1), to interpolate the state it shows.
+class FrameLoop {
+ public:
+  using Update = std::function<void(double dt)>;
+  using Render = std::function<void(double alpha)>;
+  FrameLoop(const std::chrono::nanoseconds frame_period,
+      const std::chrono::nanoseconds timestep,
+      const SkipPolicy policy = SkipPolicy::SKIP,
+      const std::size_t max_updates = 5, const std::size_t history = 1024);
+  explicit FrameLoop(const std::chrono::nanoseconds frame_period)
+    : FrameLoop(frame_period, frame_period) {}
+  void run(const Update &, const Render &);
+  // may be called from the callbacks or from another thread
+  void stop() { stopped = true; }
+  FrameStats stats() const;
+ private:
+  void push_frame_time(const std::int64_t ns);
+  std::int64_t period;
+  std::int64_t timestep;
+  SkipPolicy policy;
+  std::size_t max_updates;
+  std::atomic<bool> stopped;
+  std::vector<std::int64_t> frame_times;
+  std::size_t next_sample;
+  std::size_t frames;
+  std::size_t missed;
+};
+
+} // namespace cui3d
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef _HEADER_CUI3D_FRAME_SERVER_HPP_
+#define _HEADER_CUI3D_FRAME_SERVER_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "cui3d.hpp"
+#include "status.hpp"
+
+namespace cui3d {
+
+// Serves one rendered frame stream to any number of terminals connected
+// to a Unix domain socket; e.g. `nc -U path` or `socat - UNIX:path`.
+// Each client gets ANSI output taking it from the last frame it fully
+// received to the newest one. A client still draining older output just
+// misses the frames in between, so nobody waits on the slowest reader.
+class FrameServer {
+ public:
+  FrameServer() : listen_fd(-1), wake_pipe{-1, -1}, latest_id(0),
+    stopped(false), clients_connected(0), frames_skipped(0), encoded_id(0) {}
+  FrameServer(const FrameServer &) = delete;
+  ~FrameServer();
+  status_t listen(const std::string &path);
+  void publish(const CuiImage &);
+  void close();
+  std::size_t client_count() const;
+  // frames that some client never saw, summed over clients
+  std::uint64_t skipped_frames() const;
+ private:
+  struct Client {
+    int fd;
+    std::uint64_t shown_id;
+    std::shared_ptr<const CuiImage> shown;
+    std::shared_ptr<const std::string> out;
+    std::size_t written;
+  };
+  void serve();
+  bool flush(Client &, const std::uint64_t id,
+      const std::shared_ptr<const CuiImage> &latest);
+  int listen_fd;
+  int wake_pipe[2];
+  std::string path;
+  mutable std::mutex mtx;
+  std::shared_ptr<const CuiImage> latest;
+  std::uint64_t latest_id;
+  bool stopped;
+  std::size_t clients_connected;
+  std::uint64_t frames_skipped;
+  std::vector<Client> clients;
+  // output for the current frame keyed by the frame a client last saw
+  std::unordered_map<std::uint64_t, std::shared_ptr<const std::string>> encoded;
+  std::uint64_t encoded_id;
+  std::thread server;
+};
+
+} // namespace cui3d
+
+#endif
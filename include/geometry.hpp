@@ -36,10 +36,18 @@ struct Line {
   Line(const Vec3D &a, const Vec3D &b) : a(a), b(b) {}
 };
 
+struct Ray {
+  Vec3D origin, direction;
+  Ray(const Vec3D &origin, const Vec3D &direction)
+    : origin(origin), direction(direction) {}
+};
+
 struct Triangle {
   Vec3D &operator[](std::size_t index) { return verticies[index]; }
   const Vec3D &operator[](std::size_t index) const { return verticies[index]; }
   std::array<Vec3D, 3> verticies;
+  Triangle()
+    : verticies{Vec3D(0, 0, 0), Vec3D(0, 0, 0), Vec3D(0, 0, 0)} {}
   Triangle(Vec3D a, Vec3D b, Vec3D c)
     : verticies{a, b, c} {}
 };
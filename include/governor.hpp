@@ -0,0 +1,36 @@
+#ifndef _HEADER_CUI3D_GOVERNOR_HPP_
+#define _HEADER_CUI3D_GOVERNOR_HPP_
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include "cui3d.hpp"
+
+namespace cui3d {
+
+// Keeps render time under a budget by lowering the internal resolution
+// and upscaling the result. Resolution is only raised again after the
+// estimated cost stays well below budget for hold_frames frames.
+// min_scale is clamped to [0.01, 1].
+class ResolutionGovernor {
+ public:
+  using Renderer = std::function<CuiImage(std::size_t, std::size_t)>;
+  explicit ResolutionGovernor(const std::chrono::nanoseconds budget,
+      const double min_scale = 0.25, const std::size_t hold_frames = 30);
+  CuiImage render(const std::size_t height, const std::size_t width,
+      const Renderer &);
+  double get_scale() const { return levels[level]; }
+  std::chrono::nanoseconds get_last_render_time() const { return last_time; }
+ private:
+  std::chrono::nanoseconds budget;
+  std::size_t hold_frames;
+  std::vector<double> levels;
+  std::size_t level;
+  std::size_t calm_frames;
+  double cost;
+  std::chrono::nanoseconds last_time;
+};
+
+} // namespace cui3d
+
+#endif
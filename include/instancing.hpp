@@ -0,0 +1,27 @@
+#ifndef _HEADER_CUI3D_INSTANCING_HPP_
+#define _HEADER_CUI3D_INSTANCING_HPP_
+#include <memory>
+#include <vector>
+#include "geometry.hpp"
+#include "polygon.hpp"
+#include "texture.hpp"
+
+namespace cui3d {
+
+struct Instance {
+  Transform3D transform;
+  // the mesh texture is used when empty
+  Texture texture;
+};
+
+// One mesh drawn once per instance. Instances are culled by their
+// transformed bounds and their triangles only exist while projecting,
+// so memory grows with the instance count, not with copies of the mesh.
+struct InstancedPolygon {
+  std::shared_ptr<const Polygon> mesh;
+  std::vector<Instance> instances;
+};
+
+} // namespace cui3d
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef _HEADER_CUI3D_LIGHTING_HPP_
+#define _HEADER_CUI3D_LIGHTING_HPP_
+#include <array>
+#include <string>
+#include <vector>
+#include "geometry.hpp"
+#include "pixel.hpp"
+
+namespace cui3d {
+
+constexpr char default_ramp[] = " .:-=+*#%@";
+
+// intensity in [0, 1] to a pixel, darkest first; built once up front.
+// Empty glyphs or colors fall back to the defaults.
+class ShadeRamp {
+ public:
+  static constexpr std::size_t levels = 256;
+  explicit ShadeRamp(const std::string &glyphs = default_ramp,
+      const std::vector<Color> &colors = {Color::WHITE},
+      const Color background = Color::BLACK);
+  Pixel operator()(const double intensity) const {
+    double k = intensity * levels;
+    return table[k <= 0 ? 0 : k >= levels ? levels - 1 : (std::size_t)k];
+  }
+ private:
+  std::array<Pixel, levels> table;
+};
+
+struct DirectionalLight {
+  Vec3D direction;
+  double intensity;
+};
+
+// Triangles are two sided, a light reaches both faces alike.
+struct Lighting {
+  double ambient = 0.1;
+  std::vector<DirectionalLight> lights = {{Vec3D(-1, -1, 2), 0.9}};
+  ShadeRamp ramp;
+};
+
+// one pixel per triangle, all lights applied over the whole list at once
+void shade(const Lighting &, const std::vector<Triangle> &, std::vector<Pixel> &);
+
+} // namespace cui3d
+
+#endif
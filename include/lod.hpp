@@ -0,0 +1,40 @@
+#ifndef _HEADER_CUI3D_LOD_HPP_
+#define _HEADER_CUI3D_LOD_HPP_
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include "geometry.hpp"
+#include "mesh.hpp"
+#include "polygon.hpp"
+#include "texture.hpp"
+
+namespace cui3d {
+
+// levels[0] is the full mesh, every following level is coarser.
+// errors[k] bounds how far levels[k] strays from the full mesh.
+// Every level has the texture given to make_lod; lighting may be set on
+// the levels afterwards, per vertex uvs are not kept since decimation
+// replaces the faces they belong to.
+struct LODPolygon {
+  std::vector<Polygon> levels;
+  std::vector<double> errors;
+  Vec3D center;
+  double radius;
+};
+
+// Quadric error edge collapse until at most target faces remain or the
+// next collapse would move the surface further than max_error.
+Mesh decimate(const Mesh &, const std::size_t target,
+    const double max_error = std::numeric_limits<double>::infinity(),
+    double *error = nullptr);
+LODPolygon make_lod(const Mesh &, const Texture &texture = defaultTexture,
+    const std::size_t level_count = 8, const double ratio = 0.25);
+LODPolygon applyTransform(const LODPolygon &, const Transform3D &);
+// the coarsest level whose error projects to less than threshold cells
+const Polygon &select_level(const Camera &, const LODPolygon &,
+    const std::size_t height, const std::size_t width,
+    const double threshold = 0.5);
+
+} // namespace cui3d
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef _HEADER_CUI3D_MAPPED_FILE_HPP_
+#define _HEADER_CUI3D_MAPPED_FILE_HPP_
+#include <cstddef>
+#include <string>
+#include "status.hpp"
+
+namespace cui3d {
+
+// read-only mapping of a whole file
+class MappedFile {
+ public:
+  MappedFile() : ptr(nullptr), length(0) {}
+  MappedFile(const MappedFile &) = delete;
+  MappedFile(MappedFile &&);
+  MappedFile &operator=(MappedFile &&);
+  ~MappedFile();
+  status_t open(const std::string &path);
+  void close();
+  const char *data() const { return static_cast<const char *>(ptr); }
+  std::size_t size() const { return length; }
+ private:
+  void *ptr;
+  std::size_t length;
+};
+
+} // namespace cui3d
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef _HEADER_CUI3D_MESH_HPP_
+#define _HEADER_CUI3D_MESH_HPP_
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "geometry.hpp"
+#include "polygon.hpp"
+#include "status.hpp"
+
+namespace cui3d {
+
+struct Mesh {
+  using Face = std::array<std::uint32_t, 3>;
+  std::vector<Vec3D> vertices;
+  std::vector<Face> faces;
+};
+
+Polygon to_polygon(const Mesh &);
+
+// Wavefront OBJ: v and f records, faces are fan triangulated
+status_t load_obj(const std::string &path, Mesh &);
+// binary STL
+status_t load_stl(const std::string &path, Mesh &);
+
+} // namespace cui3d
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef _HEADER_CUI3D_PARALLEL_HPP_
+#define _HEADER_CUI3D_PARALLEL_HPP_
+#include <algorithm>
+#include <cstddef>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace cui3d {
+
+// when nonzero, caps worker_count() on the calling thread; set by threads
+// that are already one of a full set of workers
+inline std::size_t &worker_limit() {
+  static thread_local std::size_t limit = 0;
+  return limit;
+}
+
+inline std::size_t worker_count() {
+  if (worker_limit()) return worker_limit();
+  std::size_t th = std::thread::hardware_concurrency();
+  return th ? th : 1;
+}
+
+// calls f(begin, end, worker) on contiguous ranges of [0, n), one per worker
+template <typename F>
+void parallel_for(const std::size_t n, const std::size_t workers, F f) {
+  std::size_t th = std::max<std::size_t>(1, std::min(workers, n));
+  if (th == 1) {
+    f(std::size_t(0), n, std::size_t(0));
+    return;
+  }
+  std::vector<std::future<void>> vf;
+  for (std::size_t t = 0; t < th; ++t)
+    vf.push_back(std::async(std::launch::async, f,
+          n * t / th, n * (t + 1) / th, t));
+  for (auto &&f : vf) f.get();
+}
+
+template <typename F>
+void parallel_for(const std::size_t n, F f) {
+  parallel_for(n, worker_count(), f);
+}
+
+// calls f(i, worker) for every i in [0, n), worker w taking i = w, w + th, ...
+// so that neighbouring items of uneven cost land on different workers
+template <typename F>
+void parallel_interleave(const std::size_t n, const std::size_t workers, F f) {
+  std::size_t th = std::max<std::size_t>(1, std::min(workers, n));
+  auto run = [=](const std::size_t t) {
+    for (std::size_t i = t; i < n; i += th) f(i, t);
+  };
+  if (th == 1) {
+    run(0);
+    return;
+  }
+  std::vector<std::future<void>> vf;
+  for (std::size_t t = 0; t < th; ++t)
+    vf.push_back(std::async(std::launch::async, run, t));
+  for (auto &&f : vf) f.get();
+}
+
+} // namespace cui3d
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef _HEADER_CUI3D_PARTICLES_HPP_
+#define _HEADER_CUI3D_PARTICLES_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "cui3d.hpp"
+#include "geometry.hpp"
+#include "polygon.hpp"
+
+namespace cui3d {
+
+// Point particles kept as one float array per field so update and
+// projection run as plain loops over contiguous memory. Each particle
+// covers at most one cell; the nearest particle in a cell wins.
+class ParticleSystem {
+ public:
+  explicit ParticleSystem(const std::size_t capacity);
+  std::size_t size() const { return count; }
+  std::size_t capacity() const { return x.size(); }
+  // false when full or for a lifetime that is not positive
+  bool emit(const Vec3D &pos, const Vec3D &velocity, const double lifetime);
+  // moves every particle and drops those past their lifetime
+  void update(const double dt, const Vec3D &gravity = Vec3D(0, 0, 0));
+  void clear() { count = 0; }
+  // particles behind depth, from Camera::render, are hidden
+  CuiImage render(const Camera &, CuiImage &, const DepthBuffer *depth = nullptr);
+  // glyphs[k] is drawn over the k-th equal part of a particle's life
+  std::vector<Pixel> glyphs;
+ private:
+  std::size_t count;
+  std::vector<float> x, y, z, vx, vy, vz, age, lifetime;
+  // per worker nearest (depth, index) key for every cell
+  std::vector<std::vector<std::uint64_t>> nearest;
+};
+
+} // namespace cui3d
+
+#endif
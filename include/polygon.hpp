@@ -3,9 +3,12 @@
 #include "cui3d.hpp"
 #include <cstddef>
 #include <array>
+#include <memory>
 #include <vector>
 #include <boost/optional.hpp>
+#include <boost/variant.hpp>
 #include "geometry.hpp"
+#include "lighting.hpp"
 #include "texture.hpp"
 
 namespace cui3d {
@@ -16,6 +19,11 @@ struct Polygon {
   using table = std::vector<std::vector<T>>;
   std::vector<Triangle> triangles;
   Texture texture;
+  // when set, every triangle is flat shaded instead of textured
+  std::shared_ptr<const Lighting> lighting;
+  // per triangle; when set together with uv_texture it replaces texture
+  std::vector<std::array<TexCoord, 3>> uvs;
+  UVTexture uv_texture;
   Polygon() : texture(defaultTexture) {}
   Polygon(const Polygon &) = default;
   Polygon(Polygon &&) = default;
@@ -23,17 +31,85 @@ struct Polygon {
 
 Polygon make_cuboid(const Vec3D &, const Vec3D &);
 Polygon applyTransform(const Polygon &, const Transform3D &);
+// texture coordinates for every vertex from the plane projection
+void map_uvs(Polygon &, const PlaneMappingTexture &);
+
+// camera space depth of every cell drawn by the last render, 1e+8 where
+// nothing was drawn; lets other primitives be depth tested against it
+struct DepthBuffer {
+  std::size_t height = 0, width = 0;
+  std::vector<double> depth;
+  double operator()(const std::size_t i, const std::size_t j) const {
+    return depth[i * width + j];
+  }
+};
+
+struct LODPolygon;
+struct InstancedPolygon;
+class VoxelGrid;
+
+// SPANS gives the FILL image but resolves each row with a span buffer,
+// shading every cell once; it pays off with heavy overdraw.
+// WIREFRAME draws every distinct triangle edge and BOUNDS the box around
+// every object, both as lines without depth test or shading
+enum class RenderMode { FILL, WIREFRAME, BOUNDS, SPANS };
+
+// a texture whose type is known to the renderer, or any other callable
+// behind a std::function
+using TextureRef = boost::variant<const FillfullTexture *,
+      const PlaneMappingTexture *, const Texture *>;
 
 class Camera {
  public:
-  Camera() : camera_pos(0, 0, -1.0), camera_direction(0, 0, 1.0) {};
+  Camera() : camera_pos(0, 0, -1.0), camera_direction(0, 0, 1.0),
+    mode(RenderMode::FILL) {};
   CuiImage render(CuiImage &, const std::vector<Polygon> &) const;
+  CuiImage render(CuiImage &, const std::vector<const Polygon *> &) const;
+  CuiImage render(CuiImage &, const std::vector<const Polygon *> &,
+      DepthBuffer &) const;
+  // every polygon drawn with texture instead of its own. T is
+  // FillfullTexture, PlaneMappingTexture or Texture; the first two are
+  // inlined into the fill loop without looking into a std::function
+  template <typename T>
+  CuiImage render(CuiImage &img, const std::vector<const Polygon *> &vp,
+      const T &texture) const {
+    return render_textured(img, vp, TextureRef(&texture));
+  }
+  // picks a level of detail per object, see lod.hpp
+  CuiImage render(CuiImage &, const std::vector<LODPolygon> &) const;
+  // see instancing.hpp
+  CuiImage render(CuiImage &, const std::vector<InstancedPolygon> &) const;
+  // one ray per cell through the voxels, see voxel.hpp
+  CuiImage render(CuiImage &, const VoxelGrid &) const;
+  // ray through screen position (x, y) in [-0.5, 0.5], as used by render
+  Ray ray(const double x, const double y) const;
+  // conservative: false only if nothing inside the box can reach the screen
+  bool may_see(const Vec3D &lower, const Vec3D &upper) const;
   Vec3D camera_pos;
   Vec3D camera_direction;
+  RenderMode mode;
  private:
-  CuiImage render_line(CuiImage &, const std::vector<Polygon> &, const int i) const;
-  std::vector<Polygon> normalize(const std::vector<Polygon> &) const;
+  CuiImage render_textured(CuiImage &, const std::vector<const Polygon *> &,
+      const TextureRef &) const;
+};
+
+// a camera drawing into the height x width rectangle at (row, col)
+struct Viewport {
+  Camera camera;
+  std::size_t row, col;
+  std::size_t height, width;
 };
 
+// all viewports share one pass over the world geometry and are
+// rasterized together
+CuiImage render(CuiImage &, const std::vector<Viewport> &,
+    const std::vector<Polygon> &);
+CuiImage render(CuiImage &, const std::vector<Viewport> &,
+    const std::vector<const Polygon *> &);
+CuiImage render(CuiImage &, const std::vector<Viewport> &,
+    const std::vector<const Polygon *> &,
+    const std::vector<const InstancedPolygon *> &,
+    DepthBuffer *depth = nullptr);
+
 } // namespace cui3d
 #endif
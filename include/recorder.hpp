@@ -0,0 +1,79 @@
+#ifndef _HEADER_CUI3D_RECORDER_HPP_
+#define _HEADER_CUI3D_RECORDER_HPP_
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "cui3d.hpp"
+#include "mapped_file.hpp"
+#include "status.hpp"
+
+namespace cui3d {
+
+// Recording file, little endian:
+//   "CUI3DREC" u32 version
+//   frames: u32 size (bytes that follow), u64 timestamp_ns,
+//           u16 height, u16 width, u8 keyframe, u32 run_count,
+//           runs: u16 row, u16 col, u16 length, length x (u8 ch, u8 attr)
+// attr is foreground * 8 + background, or 0xff for a cleared cell.
+// A keyframe holds the whole frame as changes from a blank image.
+constexpr std::uint32_t recording_version = 1;
+
+class FrameRecorder {
+ public:
+  explicit FrameRecorder(const std::size_t keyframe_interval = 120)
+    : keyframe_interval(keyframe_interval), frames(0) {}
+  status_t open(const std::string &path);
+  // next is the frame after runs were applied
+  void record(const CuiImage &next, const std::vector<CellRun> &runs);
+  void record(const CuiImage &next);
+  // with a given timestamp instead of the time since open, for frames
+  // that are not rendered in real time
+  void record(const CuiImage &next, const std::chrono::nanoseconds timestamp);
+  status_t close();
+ private:
+  void write(const CuiImage &next, const std::vector<CellRun> &runs,
+      const std::chrono::nanoseconds timestamp);
+  std::size_t keyframe_interval;
+  std::size_t frames;
+  std::ofstream ofs;
+  std::string buffer;
+  CuiImage last;
+  std::chrono::steady_clock::time_point start;
+};
+
+class FramePlayer {
+ public:
+  status_t open(const std::string &path);
+  std::size_t frame_count() const { return index.size(); }
+  std::chrono::nanoseconds timestamp(const std::size_t i) const {
+    return std::chrono::nanoseconds(i < index.size() ? index[i].timestamp : 0);
+  }
+  // decodes from the nearest keyframe unless already on the way; an
+  // empty image when i is out of range
+  const CuiImage &frame(const std::size_t i);
+  // speed <= 0 plays as fast as the terminal allows
+  void play(Screen &, const double speed = 1.0);
+ private:
+  struct Entry {
+    // runs lie in [offset, end)
+    std::size_t offset, end;
+    std::uint64_t timestamp;
+    std::size_t height, width;
+    bool keyframe;
+    std::size_t run_count;
+  };
+  void apply_frame(const Entry &);
+  MappedFile file;
+  std::vector<Entry> index;
+  CuiImage current;
+  CuiImage none;
+  std::size_t current_index = 0;
+  bool has_current = false;
+};
+
+} // namespace cui3d
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef _HEADER_CUI3D_SCENE_FILE_HPP_
+#define _HEADER_CUI3D_SCENE_FILE_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "bvh.hpp"
+#include "geometry.hpp"
+#include "mapped_file.hpp"
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include "polygon.hpp"
+#include "status.hpp"
+
+namespace cui3d {
+
+// On disk layout, little endian. Every section is 8 byte aligned and is
+// used in place straight from the mapping.
+//   SceneHeader
+//   SceneMesh[mesh_count]
+//   double[vertex_count][3]   mesh local vertices
+//   uint32_t[face_count][3]   indices relative to the mesh first_vertex
+//   BVHNode[node_count]       optional, over the transformed meshes
+//   BVHTriangle[bvh_triangle_count]
+constexpr std::uint32_t scene_file_version = 1;
+
+struct SceneHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t mesh_count;
+  std::uint64_t vertex_count;
+  std::uint64_t face_count;
+  std::uint64_t node_count;
+  std::uint64_t bvh_triangle_count;
+  std::uint64_t mesh_offset;
+  std::uint64_t vertex_offset;
+  std::uint64_t face_offset;
+  std::uint64_t node_offset;
+  std::uint64_t bvh_triangle_offset;
+};
+
+struct SceneMesh {
+  double transform[4][4];
+  double lower[3];
+  double upper[3];
+  std::uint64_t first_vertex;
+  std::uint64_t vertex_count;
+  std::uint64_t first_face;
+  std::uint64_t face_count;
+};
+
+class SceneWriter {
+ public:
+  void add(const Mesh &, const Transform3D &trans = Transform3D());
+  status_t write(const std::string &path, const bool with_bvh) const;
+ private:
+  std::vector<Mesh> meshes;
+  std::vector<Transform3D> transforms;
+};
+
+// open() checks the header and the section and mesh ranges only, so it
+// costs a few page faults however large the file is. Face indices are
+// checked as polygon() reads them, faces pointing outside their mesh are
+// dropped, and the tree as bvh() reads it. verify() checks everything
+// up front.
+class SceneFile {
+ public:
+  status_t open(const std::string &path);
+  // PARSE_ERROR if any face or the BVH is damaged
+  status_t verify() const;
+  std::size_t mesh_count() const { return header ? header->mesh_count : 0; }
+  const SceneMesh &mesh(const std::size_t index) const { return meshes[index]; }
+  const double (*get_vertices() const)[3] { return vertices; }
+  const std::uint32_t (*get_faces() const)[3] { return faces; }
+  Transform3D transform(const std::size_t index) const;
+  Polygon polygon(const std::size_t index,
+      const std::size_t workers = worker_count()) const;
+  std::vector<Polygon> polygons() const;
+  bool has_bvh() const { return header && header->node_count > 0; }
+  // reads the mapping in place, valid while the file stays open; empty
+  // if the tree is damaged
+  BVH bvh() const;
+ private:
+  static bool valid_face(const SceneMesh &m, const std::uint32_t *f) {
+    return f[0] < m.vertex_count && f[1] < m.vertex_count && f[2] < m.vertex_count;
+  }
+  bool valid_bvh() const;
+  MappedFile file;
+  const SceneHeader *header = nullptr;
+  const SceneMesh *meshes = nullptr;
+  const double (*vertices)[3] = nullptr;
+  const std::uint32_t (*faces)[3] = nullptr;
+  const BVHNode *nodes = nullptr;
+  const BVHTriangle *bvh_triangles = nullptr;
+};
+
+} // namespace cui3d
+
+#endif
@@ -6,6 +6,8 @@ namespace cui3d {
 enum class status_t {
   SUCCESS = 0,
   UNKNOWN_ERROR,
+  IO_ERROR,
+  PARSE_ERROR,
 };
 
 } // namespace cui3d
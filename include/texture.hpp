@@ -1,6 +1,10 @@
 #ifndef _HEADER_CUI3D_TEXTURE_HPP_
 #define _HEADER_CUI3D_TEXTURE_HPP_
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <functional>
+#include <vector>
 #include "pixel.hpp"
 #include "geometry.hpp"
 
@@ -8,6 +12,13 @@ namespace cui3d {
 
 using Texture = std::function<Pixel(const Vec3D &)>;
 
+struct TexCoord {
+  double u, v;
+};
+
+// sampled at texture coordinates interpolated from the triangle vertices
+using UVTexture = std::function<Pixel(const TexCoord &)>;
+
 extern Texture defaultTexture;
 
 class FillfullTexture {
@@ -17,16 +28,31 @@ class FillfullTexture {
   Pixel operator()(const Vec3D &) const { return pixel; }
 };
 
+// Projects onto the plane through origin with normal given by theta
+// (from z) and phi (around z), rotated by rot inside the plane. tp is
+// repeated every width x height units; without it every cell is '@'.
 class PlaneMappingTexture {
  public:
-   std::vector<std::vector<Pixel>> tp;
-  Vec3D origin;
-  double theta;
-  double phi;
-  double width;
-  double height;
-  double rot;
-  Pixel operator()(const Vec3D &vec);
+  std::vector<std::vector<Pixel>> tp;
+  Vec3D origin = Vec3D(0, 0, 0);
+  double theta = 0;
+  double phi = 0;
+  double width = 1;
+  double height = 1;
+  double rot = 0;
+  // unit vectors along u and v
+  void axes(Vec3D &eu, Vec3D &ev) const;
+  TexCoord map(const Vec3D &vec) const;
+  Pixel operator()(const TexCoord &uv) const {
+    if (tp.empty() || tp[0].empty()) return Pixel('@', Color::RED, Color::WHITE);
+    // interpolated coordinates can blow up at grazing angles
+    if (!std::isfinite(uv.u) || !std::isfinite(uv.v)) return tp[0][0];
+    const std::size_t rows = tp.size(), cols = tp[0].size();
+    std::size_t i = (uv.v - std::floor(uv.v)) * rows;
+    std::size_t j = (uv.u - std::floor(uv.u)) * cols;
+    return tp[std::min(i, rows - 1)][std::min(j, cols - 1)];
+  }
+  Pixel operator()(const Vec3D &vec) const { return (*this)(map(vec)); }
 };
 
 } // namespace cui3d
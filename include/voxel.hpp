@@ -0,0 +1,58 @@
+#ifndef _HEADER_CUI3D_VOXEL_HPP_
+#define _HEADER_CUI3D_VOXEL_HPP_
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "cui3d.hpp"
+#include "geometry.hpp"
+
+namespace cui3d {
+
+struct Voxel {
+  int x, y, z;
+  std::uint8_t value;
+};
+
+// Dense voxels, 0 is empty. Voxel (x, y, z) fills the cube from
+// origin + voxel_size * (x, y, z) to origin + voxel_size * (x+1, y+1, z+1).
+// Every value has a pixel per face orientation, x, y and z, in palette.
+// A count of filled voxels per brick x brick x brick block lets rays jump
+// over empty space.
+class VoxelGrid {
+ public:
+  static constexpr std::size_t brick = 4;
+  VoxelGrid(const std::size_t nx, const std::size_t ny, const std::size_t nz,
+      const Vec3D &origin = Vec3D(0, 0, 0), const double voxel_size = 1.0);
+  // the smallest grid holding the voxels, which sit on a lattice with
+  // voxel (0, 0, 0) at lattice_origin
+  static VoxelGrid from_voxels(const std::vector<Voxel> &,
+      const double voxel_size = 1.0,
+      const Vec3D &lattice_origin = Vec3D(0, 0, 0));
+  void set(const std::size_t x, const std::size_t y, const std::size_t z,
+      const std::uint8_t value);
+  std::uint8_t get(const std::size_t x, const std::size_t y, const std::size_t z) const {
+    return cells[(z * ny + y) * nx + x];
+  }
+  std::uint16_t brick_count(const std::size_t bx, const std::size_t by,
+      const std::size_t bz) const {
+    return bricks[(bz * bny + by) * bnx + bx];
+  }
+  std::size_t get_nx() const { return nx; }
+  std::size_t get_ny() const { return ny; }
+  std::size_t get_nz() const { return nz; }
+  const Vec3D &get_origin() const { return origin; }
+  double get_voxel_size() const { return voxel_size; }
+  std::vector<std::array<Pixel, 3>> palette;
+ private:
+  std::size_t nx, ny, nz;
+  std::size_t bnx, bny, bnz;
+  Vec3D origin;
+  double voxel_size;
+  std::vector<std::uint8_t> cells;
+  std::vector<std::uint16_t> bricks;
+};
+
+} // namespace cui3d
+
+#endif
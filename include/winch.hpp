@@ -0,0 +1,26 @@
+#ifndef _HEADER_CUI3D_WINCH_HPP_
+#define _HEADER_CUI3D_WINCH_HPP_
+
+namespace cui3d {
+
+// SIGWINCH shared by everything that follows the terminal size. The
+// handler is installed for the first subscription and chains to the one
+// it replaced, which is put back when the last subscription ends, in
+// whatever order they end.
+class WinchSubscription {
+ public:
+  // a byte is written to fd on every resize; at most 16 subscriptions
+  // get one at a time
+  explicit WinchSubscription(const int fd = -1);
+  WinchSubscription(const WinchSubscription &) = delete;
+  WinchSubscription &operator=(const WinchSubscription &) = delete;
+  ~WinchSubscription();
+  // resizes seen since the first subscription, for polling
+  static unsigned long generation();
+ private:
+  int slot;
+};
+
+} // namespace cui3d
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef _HEADER_CUI3D_WORLD_HPP_
+#define _HEADER_CUI3D_WORLD_HPP_
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "cui3d.hpp"
+#include "geometry.hpp"
+#include "polygon.hpp"
+#include "scene_file.hpp"
+#include "status.hpp"
+
+namespace cui3d {
+
+struct WorldStats {
+  std::size_t chunk_count;
+  std::size_t resident_chunks;
+  std::size_t resident_bytes;
+  std::size_t pending_chunks;
+  std::uint64_t loads;
+  std::uint64_t evictions;
+  // chunks a frame wanted but had to draw without
+  std::uint64_t misses;
+  // chunks bigger than the whole budget, never loaded
+  std::size_t oversized_chunks;
+};
+
+// A scene file split into cubic chunks by mesh centre. Only chunks in
+// view and within view_distance are turned into polygons, by a loader
+// thread, nearest first. Least recently drawn chunks are dropped to stay
+// under budget bytes. render never waits for the loader: a chunk that is
+// not resident yet is simply missing from that frame, one that would not
+// fit even in an empty budget is never loaded.
+class ChunkedWorld {
+ public:
+  ChunkedWorld(const std::size_t budget, const double chunk_size = 1.0,
+      const double view_distance = 8.0);
+  ChunkedWorld(const ChunkedWorld &) = delete;
+  ~ChunkedWorld();
+  status_t open(const std::string &path);
+  void close();
+  CuiImage render(const Camera &, CuiImage &);
+  WorldStats stats() const;
+ private:
+  using Key = std::tuple<int, int, int>;
+  struct Chunk {
+    std::vector<std::size_t> meshes;
+    Vec3D lower, upper;
+    std::size_t bytes;
+    std::shared_ptr<const std::vector<Polygon>> polygons;
+    std::list<Chunk *>::iterator lru;
+    std::uint64_t used;
+  };
+  void load();
+  bool make_room(const std::size_t bytes);
+  void evict(Chunk &);
+  std::size_t budget;
+  double chunk_size;
+  double view_distance;
+  SceneFile file;
+  std::map<Key, Chunk> chunks;
+  mutable std::mutex mtx;
+  std::condition_variable cv;
+  // most recently drawn first
+  std::list<Chunk *> lru;
+  // wanted by the last frame and not resident, nearest last
+  std::vector<Chunk *> queue;
+  std::size_t resident_bytes;
+  std::uint64_t frame;
+  std::uint64_t loads, evictions, misses;
+  std::size_t oversized;
+  bool stopped;
+  std::thread loader;
+};
+
+} // namespace cui3d
+
+#endif
@@ -0,0 +1,55 @@
+#include "ansi.hpp"
+
+namespace cui3d {
+
+namespace {
+
+// Color order differs from the ANSI one
+constexpr int ansi_color[8] = {0, 4, 2, 6, 1, 5, 3, 7};
+
+void append_int(std::string &out, std::size_t v) {
+  char buf[20];
+  int len = 0;
+  do {
+    buf[len++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  while (len) out.push_back(buf[--len]);
+}
+
+} // namespace
+
+std::string to_ansi(const std::vector<CellRun> &runs, const bool clear) {
+  std::string out;
+  if (clear) out += "\x1b[0m\x1b[2J";
+  int attr = -1;
+  for (const CellRun &run : runs) {
+    out += "\x1b[";
+    append_int(out, run.row + 1);
+    out.push_back(';');
+    append_int(out, run.col + 1);
+    out.push_back('H');
+    for (std::size_t k = 0; k < run.pixels.size(); ++k) {
+      const Pixel &p = run.pixels[k];
+      int next = run.visible[k] ? static_cast<int>(p.foreground_color) * 8
+        + static_cast<int>(p.background_color) : 64;
+      if (next != attr) {
+        if (next == 64) {
+          out += "\x1b[0m";
+        } else {
+          out += "\x1b[3";
+          out.push_back('0' + ansi_color[next / 8]);
+          out += ";4";
+          out.push_back('0' + ansi_color[next % 8]);
+          out.push_back('m');
+        }
+        attr = next;
+      }
+      out.push_back(run.visible[k] ? p.ch : ' ');
+    }
+  }
+  if (attr != -1 && attr != 64) out += "\x1b[0m";
+  return out;
+}
+
+} // namespace cui3d
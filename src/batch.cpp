@@ -0,0 +1,94 @@
+#include "batch.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ansi.hpp"
+#include "recorder.hpp"
+
+namespace cui3d {
+
+namespace {
+
+constexpr std::size_t no_frame = std::numeric_limits<std::size_t>::max();
+
+} // namespace
+
+void render_batch(const std::size_t frames, const std::size_t height,
+    const std::size_t width, const BatchScene &scene, const BatchSink &sink,
+    const std::size_t workers) {
+  const std::size_t th = std::max<std::size_t>(1, std::min(workers, frames));
+  // frame k is rendered into slot k % slots once frame k - slots is written
+  const std::size_t slots = 2 * th;
+  std::vector<CuiImage> images(slots, CuiImage(height, width));
+  std::vector<std::size_t> ready(slots, no_frame);
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::size_t next = 0, written = 0;
+  auto work = [&] {
+    worker_limit() = 1;
+    while (true) {
+      std::size_t k;
+      {
+        std::unique_lock<std::mutex> lk(mtx);
+        cv.wait(lk, [&] { return next >= frames || next < written + slots; });
+        if (next >= frames) return;
+        k = next++;
+      }
+      CuiImage &img = images[k % slots];
+      for (auto &row : img.visible) std::fill(std::begin(row), std::end(row), false);
+      scene(k, img);
+      {
+        std::lock_guard<std::mutex> lk(mtx);
+        ready[k % slots] = k;
+      }
+      cv.notify_all();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < th; ++t) threads.emplace_back(work);
+  for (std::size_t k = 0; k < frames; ++k) {
+    {
+      std::unique_lock<std::mutex> lk(mtx);
+      cv.wait(lk, [&] { return ready[k % slots] == k; });
+    }
+    sink(k, images[k % slots]);
+    {
+      std::lock_guard<std::mutex> lk(mtx);
+      ready[k % slots] = no_frame;
+      ++written;
+    }
+    cv.notify_all();
+  }
+  for (auto &t : threads) t.join();
+}
+
+status_t render_batch(const std::string &path, const std::size_t frames,
+    const std::size_t height, const std::size_t width,
+    const std::chrono::nanoseconds period, const BatchScene &scene,
+    const std::size_t workers) {
+  FrameRecorder recorder;
+  status_t st = recorder.open(path);
+  if (st != status_t::SUCCESS) return st;
+  render_batch(frames, height, width, scene,
+      [&](std::size_t k, const CuiImage &img) { recorder.record(img, k * period); },
+      workers);
+  return recorder.close();
+}
+
+status_t render_batch(std::ostream &os, const std::size_t frames,
+    const std::size_t height, const std::size_t width, const BatchScene &scene,
+    const std::size_t workers) {
+  CuiImage last;
+  render_batch(frames, height, width, scene,
+      [&](std::size_t k, const CuiImage &img) {
+        os << to_ansi(diff(last, img), k == 0);
+        last = img;
+      }, workers);
+  os.flush();
+  return os ? status_t::SUCCESS : status_t::IO_ERROR;
+}
+
+} // namespace cui3d
@@ -0,0 +1,273 @@
+#include "bvh.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace cui3d {
+
+namespace {
+
+constexpr std::size_t leaf_size = 4;
+constexpr std::uint32_t no_hit = std::numeric_limits<std::uint32_t>::max();
+constexpr double epsilon = 1e-12;
+
+struct BuildRef {
+  double lower[3];
+  double upper[3];
+  double centroid[3];
+  std::uint32_t polygon_id;
+  std::uint32_t triangle_id;
+};
+
+class Builder {
+ public:
+  Builder(const std::vector<Polygon> &vp,
+      std::vector<BVHNode> &nodes, std::vector<BVHTriangle> &triangles)
+    : vp(vp), nodes(nodes), triangles(triangles) {}
+  void build(std::vector<BuildRef>::iterator, std::vector<BuildRef>::iterator);
+ private:
+  const std::vector<Polygon> &vp;
+  std::vector<BVHNode> &nodes;
+  std::vector<BVHTriangle> &triangles;
+};
+
+void Builder::build(std::vector<BuildRef>::iterator first,
+    std::vector<BuildRef>::iterator last) {
+  BVHNode node;
+  double clower[3], cupper[3];
+  for (int a = 0; a < 3; ++a) {
+    node.lower[a] = clower[a] = std::numeric_limits<double>::infinity();
+    node.upper[a] = cupper[a] = -std::numeric_limits<double>::infinity();
+  }
+  for (auto it = first; it != last; ++it) {
+    for (int a = 0; a < 3; ++a) {
+      node.lower[a] = std::min(node.lower[a], it->lower[a]);
+      node.upper[a] = std::max(node.upper[a], it->upper[a]);
+      clower[a] = std::min(clower[a], it->centroid[a]);
+      cupper[a] = std::max(cupper[a], it->centroid[a]);
+    }
+  }
+  int axis = 0;
+  for (int a = 1; a < 3; ++a)
+    if (cupper[a] - clower[a] > cupper[axis] - clower[axis]) axis = a;
+  std::size_t index = nodes.size();
+  std::size_t count = last - first;
+  if (count <= leaf_size || cupper[axis] <= clower[axis]) {
+    node.offset = triangles.size();
+    node.count = count;
+    nodes.push_back(node);
+    for (auto it = first; it != last; ++it) {
+      const Triangle &tri = vp[it->polygon_id].triangles[it->triangle_id];
+      Vec3D e1 = tri[1] - tri[0], e2 = tri[2] - tri[0];
+      BVHTriangle res;
+      for (int a = 0; a < 3; ++a) {
+        res.v0[a] = tri[0][a];
+        res.e1[a] = e1[a];
+        res.e2[a] = e2[a];
+      }
+      res.polygon_id = it->polygon_id;
+      res.triangle_id = it->triangle_id;
+      triangles.push_back(res);
+    }
+    return;
+  }
+  node.count = 0;
+  nodes.push_back(node);
+  auto mid = first + count / 2;
+  std::nth_element(first, mid, last,
+      [axis](const BuildRef &l, const BuildRef &r) {
+        return l.centroid[axis] < r.centroid[axis];
+      });
+  build(first, mid);
+  nodes[index].offset = nodes.size();
+  build(mid, last);
+}
+
+void init_lanes(const RayPacket &packet,
+    RayPacket::lanes<double> &t, RayPacket::lanes<std::uint32_t> &hit) {
+  for (std::size_t l = 0; l < packet_size; ++l) {
+    t[l] = l < packet.size ? packet.t_max[l] : -1.0;
+    hit[l] = no_hit;
+  }
+}
+
+RayPacket single(const Ray &ray, const double t_max) {
+  RayPacket packet;
+  packet.push(ray, t_max);
+  return packet;
+}
+
+} // namespace
+
+void RayPacket::push(const Ray &ray, const double t) {
+  if (size == 0) {
+    for (std::size_t l = 0; l < packet_size; ++l) {
+      ox[l] = ray.origin[0];
+      oy[l] = ray.origin[1];
+      oz[l] = ray.origin[2];
+      dx[l] = ray.direction[0];
+      dy[l] = ray.direction[1];
+      dz[l] = ray.direction[2];
+      t_max[l] = -1.0;
+    }
+  }
+  ox[size] = ray.origin[0];
+  oy[size] = ray.origin[1];
+  oz[size] = ray.origin[2];
+  dx[size] = ray.direction[0];
+  dy[size] = ray.direction[1];
+  dz[size] = ray.direction[2];
+  t_max[size] = t;
+  ++size;
+}
+
+BVH::BVH(const std::vector<Polygon> &vp) {
+  std::vector<BuildRef> refs;
+  for (std::size_t p = 0; p < vp.size(); ++p) {
+    for (std::size_t i = 0; i < vp[p].triangles.size(); ++i) {
+      const Triangle &tri = vp[p].triangles[i];
+      BuildRef ref;
+      for (int a = 0; a < 3; ++a) {
+        ref.lower[a] = std::min({tri[0][a], tri[1][a], tri[2][a]});
+        ref.upper[a] = std::max({tri[0][a], tri[1][a], tri[2][a]});
+        ref.centroid[a] = (ref.lower[a] + ref.upper[a]) / 2;
+      }
+      ref.polygon_id = p;
+      ref.triangle_id = i;
+      refs.push_back(ref);
+    }
+  }
+  if (refs.empty()) return;
+  owned_nodes.reserve(2 * refs.size() / leaf_size + 1);
+  owned_triangles.reserve(refs.size());
+  Builder(vp, owned_nodes, owned_triangles).build(std::begin(refs), std::end(refs));
+  bind();
+}
+
+BVH::BVH(const BVH &other)
+  : owned_nodes(other.owned_nodes), owned_triangles(other.owned_triangles),
+    nodes(other.nodes), node_count(other.node_count),
+    triangles(other.triangles), triangle_count(other.triangle_count) {
+  if (!owned_nodes.empty()) bind();
+}
+
+BVH &BVH::operator=(const BVH &other) {
+  if (this != &other) *this = BVH(other);
+  return *this;
+}
+
+void BVH::bind() {
+  nodes = owned_nodes.data();
+  node_count = owned_nodes.size();
+  triangles = owned_triangles.data();
+  triangle_count = owned_triangles.size();
+}
+
+template <bool any>
+void BVH::traverse(const RayPacket &packet, RayPacket::lanes<double> &t,
+    RayPacket::lanes<std::uint32_t> &hit) const {
+  if (node_count == 0) return;
+  RayPacket::lanes<double> inv[3];
+  for (std::size_t l = 0; l < packet_size; ++l) {
+    inv[0][l] = 1.0 / packet.dx[l];
+    inv[1][l] = 1.0 / packet.dy[l];
+    inv[2][l] = 1.0 / packet.dz[l];
+  }
+  const RayPacket::lanes<double> *origin[3] = {&packet.ox, &packet.oy, &packet.oz};
+  std::uint32_t stack[bvh_max_depth];
+  std::size_t sp = 0;
+  stack[sp++] = 0;
+  while (sp) {
+    std::uint32_t index = stack[--sp];
+    const BVHNode &node = nodes[index];
+    bool active = false;
+    for (std::size_t l = 0; l < packet_size; ++l) {
+      double t0 = 0, t1 = t[l];
+      for (int a = 0; a < 3; ++a) {
+        double tn = (node.lower[a] - (*origin[a])[l]) * inv[a][l];
+        double tf = (node.upper[a] - (*origin[a])[l]) * inv[a][l];
+        t0 = std::max(t0, std::min(tn, tf));
+        t1 = std::min(t1, std::max(tn, tf));
+      }
+      active |= t0 <= t1;
+    }
+    if (!active) continue;
+    if (node.count == 0) {
+      std::uint32_t l = index + 1, r = node.offset;
+      const BVHNode &left = nodes[l];
+      const BVHNode &right = nodes[r];
+      double d = 0;
+      for (int a = 0; a < 3; ++a) {
+        double dir = a == 0 ? packet.dx[0] : a == 1 ? packet.dy[0] : packet.dz[0];
+        d += (right.lower[a] + right.upper[a] - left.lower[a] - left.upper[a]) * dir;
+      }
+      if (d < 0) std::swap(l, r);
+      stack[sp++] = r;
+      stack[sp++] = l;
+      continue;
+    }
+    for (std::uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+      const BVHTriangle &tri = triangles[i];
+      for (std::size_t l = 0; l < packet_size; ++l) {
+        double px = packet.dy[l] * tri.e2[2] - packet.dz[l] * tri.e2[1];
+        double py = packet.dz[l] * tri.e2[0] - packet.dx[l] * tri.e2[2];
+        double pz = packet.dx[l] * tri.e2[1] - packet.dy[l] * tri.e2[0];
+        double det = tri.e1[0] * px + tri.e1[1] * py + tri.e1[2] * pz;
+        double inv_det = 1.0 / det;
+        double tx = packet.ox[l] - tri.v0[0];
+        double ty = packet.oy[l] - tri.v0[1];
+        double tz = packet.oz[l] - tri.v0[2];
+        double u = (tx * px + ty * py + tz * pz) * inv_det;
+        double qx = ty * tri.e1[2] - tz * tri.e1[1];
+        double qy = tz * tri.e1[0] - tx * tri.e1[2];
+        double qz = tx * tri.e1[1] - ty * tri.e1[0];
+        double v = (packet.dx[l] * qx + packet.dy[l] * qy + packet.dz[l] * qz) * inv_det;
+        double tt = (tri.e2[0] * qx + tri.e2[1] * qy + tri.e2[2] * qz) * inv_det;
+        bool ok = std::abs(det) > epsilon && u >= 0 && v >= 0 && u + v <= 1
+          && tt > epsilon && tt < t[l];
+        t[l] = ok ? (any ? -1.0 : tt) : t[l];
+        hit[l] = ok ? i : hit[l];
+      }
+    }
+    if (any) {
+      bool done = true;
+      for (std::size_t l = 0; l < packet_size; ++l) done &= t[l] < 0;
+      if (done) return;
+    }
+  }
+}
+
+boost::optional<RayHit> BVH::closest_hit(const Ray &ray,
+    const double t_max) const {
+  return closest_hit(single(ray, t_max))[0];
+}
+
+bool BVH::any_hit(const Ray &ray, const double t_max) const {
+  return any_hit(single(ray, t_max))[0];
+}
+
+BVH::PacketHits BVH::closest_hit(const RayPacket &packet) const {
+  RayPacket::lanes<double> t;
+  RayPacket::lanes<std::uint32_t> hit;
+  init_lanes(packet, t, hit);
+  traverse<false>(packet, t, hit);
+  PacketHits res;
+  for (std::size_t l = 0; l < packet.size; ++l) {
+    if (hit[l] == no_hit) continue;
+    res[l] = RayHit{t[l], triangles[hit[l]].polygon_id,
+      triangles[hit[l]].triangle_id};
+  }
+  return res;
+}
+
+std::array<bool, packet_size> BVH::any_hit(const RayPacket &packet) const {
+  RayPacket::lanes<double> t;
+  RayPacket::lanes<std::uint32_t> hit;
+  init_lanes(packet, t, hit);
+  traverse<true>(packet, t, hit);
+  std::array<bool, packet_size> res;
+  for (std::size_t l = 0; l < packet_size; ++l)
+    res[l] = l < packet.size && hit[l] != no_hit;
+  return res;
+}
+
+} // namespace cui3d
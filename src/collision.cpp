@@ -0,0 +1,343 @@
+#include "collision.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace cui3d {
+
+namespace {
+
+AABB merge(const AABB &a, const AABB &b) {
+  AABB res;
+  for (int k = 0; k < 3; ++k) {
+    res.lower[k] = std::min(a.lower[k], b.lower[k]);
+    res.upper[k] = std::max(a.upper[k], b.upper[k]);
+  }
+  return res;
+}
+
+AABB grow(const AABB &box, const double margin) {
+  const Vec3D m(margin, margin, margin);
+  return AABB{box.lower - m, box.upper + m};
+}
+
+bool contains(const AABB &outer, const AABB &inner) {
+  for (int k = 0; k < 3; ++k)
+    if (inner.lower[k] < outer.lower[k] || inner.upper[k] > outer.upper[k])
+      return false;
+  return true;
+}
+
+double area(const AABB &box) {
+  const Vec3D d = box.upper - box.lower;
+  return 2 * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+}
+
+// segment pq against t, ends and borders included; a segment parallel to
+// the plane of t never hits here, the callers cover that case
+bool segment_hits(const Vec3D &p, const Vec3D &q, const Triangle &t) {
+  const Vec3D d = q - p, e1 = t[1] - t[0], e2 = t[2] - t[0];
+  const Vec3D h = d * e2;
+  const double a = dot(e1, h);
+  if (a == 0) return false;
+  const double f = 1 / a;
+  const Vec3D s = p - t[0];
+  const double u = f * dot(s, h);
+  if (u < 0 || u > 1) return false;
+  const Vec3D r = s * e1;
+  const double v = f * dot(d, r);
+  if (v < 0 || u + v > 1) return false;
+  const double w = f * dot(e2, r);
+  return w >= 0 && w <= 1;
+}
+
+using Point2D = std::array<double, 2>;
+
+double orient(const Point2D &a, const Point2D &b, const Point2D &c) {
+  return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+bool segments_meet(const Point2D &a, const Point2D &b, const Point2D &c,
+    const Point2D &d) {
+  const double o1 = orient(a, b, c), o2 = orient(a, b, d);
+  const double o3 = orient(c, d, a), o4 = orient(c, d, b);
+  if (((o1 > 0 && o2 < 0) || (o1 < 0 && o2 > 0))
+      && ((o3 > 0 && o4 < 0) || (o3 < 0 && o4 > 0)))
+    return true;
+  auto on = [](const Point2D &p, const Point2D &q, const Point2D &r) {
+    return std::min(p[0], q[0]) <= r[0] && r[0] <= std::max(p[0], q[0])
+      && std::min(p[1], q[1]) <= r[1] && r[1] <= std::max(p[1], q[1]);
+  };
+  return (o1 == 0 && on(a, b, c)) || (o2 == 0 && on(a, b, d))
+    || (o3 == 0 && on(c, d, a)) || (o4 == 0 && on(c, d, b));
+}
+
+bool inside(const std::array<Point2D, 3> &t, const Point2D &p) {
+  const double a = orient(t[0], t[1], p), b = orient(t[1], t[2], p),
+    c = orient(t[2], t[0], p);
+  return (a >= 0 && b >= 0 && c >= 0) || (a <= 0 && b <= 0 && c <= 0);
+}
+
+// both triangles in one plane with normal n
+bool coplanar_intersect(const Triangle &a, const Triangle &b, const Vec3D &n) {
+  int drop = 0;
+  for (int k = 1; k < 3; ++k)
+    if (std::abs(n[k]) > std::abs(n[drop])) drop = k;
+  const int i = (drop + 1) % 3, j = (drop + 2) % 3;
+  std::array<Point2D, 3> p, q;
+  for (int k = 0; k < 3; ++k) {
+    p[k] = Point2D{{a[k][i], a[k][j]}};
+    q[k] = Point2D{{b[k][i], b[k][j]}};
+  }
+  for (int k = 0; k < 3; ++k)
+    for (int l = 0; l < 3; ++l)
+      if (segments_meet(p[k], p[(k+1)%3], q[l], q[(l+1)%3])) return true;
+  return inside(q, p[0]) || inside(p, q[0]);
+}
+
+// signed distances of the vertices of t from the plane of s, scaled by |n|
+bool separated_by_plane(const Triangle &s, const Vec3D &n, const Triangle &t,
+    bool &coplanar) {
+  std::array<double, 3> d;
+  double len = 0;
+  for (int k = 0; k < 3; ++k) {
+    d[k] = dot(n, t[k] - s[0]);
+    len = std::max(len, abs(t[k] - s[0]));
+  }
+  const double eps = 1e-12 * abs(n) * len;
+  for (double &x : d) if (std::abs(x) <= eps) x = 0;
+  coplanar = d[0] == 0 && d[1] == 0 && d[2] == 0;
+  return (d[0] > 0 && d[1] > 0 && d[2] > 0) || (d[0] < 0 && d[1] < 0 && d[2] < 0);
+}
+
+bool narrow(const std::vector<Triangle> &ta, const AABB &ba,
+    const std::vector<Triangle> &tb, const AABB &bb) {
+  if (!overlap(ba, bb)) return false;
+  AABB common;
+  for (int k = 0; k < 3; ++k) {
+    common.lower[k] = std::max(ba.lower[k], bb.lower[k]);
+    common.upper[k] = std::min(ba.upper[k], bb.upper[k]);
+  }
+  std::vector<const Triangle *> a, b;
+  for (const Triangle &t : ta) if (intersect(common, t)) a.push_back(&t);
+  if (a.empty()) return false;
+  for (const Triangle &t : tb) if (intersect(common, t)) b.push_back(&t);
+  for (const Triangle *s : a) {
+    const AABB sb = aabb(*s);
+    for (const Triangle *t : b)
+      if (overlap(sb, aabb(*t)) && intersect(*s, *t)) return true;
+  }
+  return false;
+}
+
+} // namespace
+
+AABB aabb(const Triangle &tri) {
+  AABB res{tri[0], tri[0]};
+  for (int v = 1; v < 3; ++v)
+    for (int k = 0; k < 3; ++k) {
+      res.lower[k] = std::min(res.lower[k], tri[v][k]);
+      res.upper[k] = std::max(res.upper[k], tri[v][k]);
+    }
+  return res;
+}
+
+AABB aabb(const std::vector<Triangle> &triangles) {
+  if (triangles.empty()) return AABB{Vec3D(0, 0, 0), Vec3D(0, 0, 0)};
+  AABB res = aabb(triangles[0]);
+  for (const Triangle &tri : triangles) res = merge(res, aabb(tri));
+  return res;
+}
+
+bool overlap(const AABB &a, const AABB &b) {
+  for (int k = 0; k < 3; ++k)
+    if (a.upper[k] < b.lower[k] || b.upper[k] < a.lower[k]) return false;
+  return true;
+}
+
+// separating axis test: box normals, triangle normal and the nine
+// cross products of box axes and triangle edges
+bool intersect(const AABB &box, const Triangle &tri) {
+  if (!overlap(box, aabb(tri))) return false;
+  const Vec3D c = 0.5 * (box.lower + box.upper), e = 0.5 * (box.upper - box.lower);
+  const std::array<Vec3D, 3> v = {{tri[0] - c, tri[1] - c, tri[2] - c}};
+  const std::array<Vec3D, 3> f = {{v[1] - v[0], v[2] - v[1], v[0] - v[2]}};
+  // moving to the centre rounds, a triangle on a face must still touch
+  const double slack = 1e-9 * (abs(c) + abs(e));
+  auto separates = [&](const Vec3D &axis) {
+    const double p0 = dot(v[0], axis), p1 = dot(v[1], axis), p2 = dot(v[2], axis);
+    const double r = e[0] * std::abs(axis[0]) + e[1] * std::abs(axis[1])
+      + e[2] * std::abs(axis[2]) + slack * abs(axis);
+    return std::min({p0, p1, p2}) > r || std::max({p0, p1, p2}) < -r;
+  };
+  const std::array<Vec3D, 3> unit = {{Vec3D(1, 0, 0), Vec3D(0, 1, 0), Vec3D(0, 0, 1)}};
+  for (const Vec3D &u : unit)
+    for (const Vec3D &edge : f)
+      if (separates(u * edge)) return false;
+  return !separates(f[0] * f[1]);
+}
+
+bool intersect(const Triangle &a, const Triangle &b) {
+  const Vec3D na = (a[1] - a[0]) * (a[2] - a[0]);
+  const Vec3D nb = (b[1] - b[0]) * (b[2] - b[0]);
+  // degenerate triangles have no area to touch
+  if (abs(na) == 0 || abs(nb) == 0) return false;
+  bool coplanar;
+  if (separated_by_plane(a, na, b, coplanar)) return false;
+  if (coplanar) return coplanar_intersect(a, b, na);
+  if (separated_by_plane(b, nb, a, coplanar)) return false;
+  // the intersection segment ends on an edge of one of them
+  for (int k = 0; k < 3; ++k)
+    if (segment_hits(a[k], a[(k+1)%3], b) || segment_hits(b[k], b[(k+1)%3], a))
+      return true;
+  return false;
+}
+
+bool intersect(const Polygon &a, const Polygon &b) {
+  return narrow(a.triangles, aabb(a.triangles), b.triangles, aabb(b.triangles));
+}
+
+std::uint32_t CollisionWorld::allocate() {
+  if (!free_nodes.empty()) {
+    std::uint32_t n = free_nodes.back();
+    free_nodes.pop_back();
+    return n;
+  }
+  nodes.emplace_back();
+  return nodes.size() - 1;
+}
+
+// walks down to the sibling that grows the total box area least
+void CollisionWorld::insert_leaf(const std::uint32_t leaf) {
+  if (root == none) {
+    root = leaf;
+    nodes[leaf].parent = none;
+    return;
+  }
+  const AABB box = nodes[leaf].box;
+  std::uint32_t index = root;
+  while (nodes[index].left != none) {
+    const Node &node = nodes[index];
+    const double combined = area(merge(node.box, box));
+    const double cost = 2 * combined;
+    const double inherited = 2 * (combined - area(node.box));
+    auto descend = [&](const std::uint32_t child) {
+      const double grown = area(merge(nodes[child].box, box));
+      return (nodes[child].left == none ? grown : grown - area(nodes[child].box))
+        + inherited;
+    };
+    const double cost_left = descend(node.left), cost_right = descend(node.right);
+    if (cost < cost_left && cost < cost_right) break;
+    index = cost_left < cost_right ? node.left : node.right;
+  }
+  const std::uint32_t sibling = index;
+  const std::uint32_t parent = allocate();
+  const std::uint32_t grand = nodes[sibling].parent;
+  nodes[parent] = Node{merge(nodes[sibling].box, box), grand, sibling, leaf, 0};
+  nodes[sibling].parent = parent;
+  nodes[leaf].parent = parent;
+  if (grand == none) root = parent;
+  else if (nodes[grand].left == sibling) nodes[grand].left = parent;
+  else nodes[grand].right = parent;
+  refit(grand);
+}
+
+void CollisionWorld::remove_leaf(const std::uint32_t leaf) {
+  if (leaf == root) {
+    root = none;
+    return;
+  }
+  const std::uint32_t parent = nodes[leaf].parent;
+  const std::uint32_t grand = nodes[parent].parent;
+  const std::uint32_t sibling = nodes[parent].left == leaf
+    ? nodes[parent].right : nodes[parent].left;
+  nodes[sibling].parent = grand;
+  if (grand == none) root = sibling;
+  else if (nodes[grand].left == parent) nodes[grand].left = sibling;
+  else nodes[grand].right = sibling;
+  free_nodes.push_back(parent);
+  refit(grand);
+}
+
+void CollisionWorld::refit(std::uint32_t node) {
+  for (; node != none; node = nodes[node].parent)
+    nodes[node].box = merge(nodes[nodes[node].left].box, nodes[nodes[node].right].box);
+}
+
+CollisionWorld::Id CollisionWorld::add(const Polygon &poly) {
+  Id id;
+  if (!free_ids.empty()) {
+    id = free_ids.back();
+    free_ids.pop_back();
+  } else {
+    id = objects.size();
+    objects.emplace_back();
+  }
+  Object &obj = objects[id];
+  obj.triangles = poly.triangles;
+  obj.box = aabb(obj.triangles);
+  obj.leaf = allocate();
+  nodes[obj.leaf] = Node{grow(obj.box, margin), none, none, none, id};
+  insert_leaf(obj.leaf);
+  return id;
+}
+
+bool CollisionWorld::update(const Id id, const Polygon &poly) {
+  if (!alive(id)) return false;
+  Object &obj = objects[id];
+  obj.triangles = poly.triangles;
+  obj.box = aabb(obj.triangles);
+  if (contains(nodes[obj.leaf].box, obj.box)) return true;
+  remove_leaf(obj.leaf);
+  nodes[obj.leaf].box = grow(obj.box, margin);
+  insert_leaf(obj.leaf);
+  ++reinserted;
+  return true;
+}
+
+bool CollisionWorld::remove(const Id id) {
+  if (!alive(id)) return false;
+  Object &obj = objects[id];
+  remove_leaf(obj.leaf);
+  free_nodes.push_back(obj.leaf);
+  obj.leaf = none;
+  obj.triangles.clear();
+  free_ids.push_back(id);
+  return true;
+}
+
+std::vector<std::pair<CollisionWorld::Id, CollisionWorld::Id>>
+CollisionWorld::candidate_pairs() const {
+  std::vector<std::pair<Id, Id>> res;
+  std::vector<std::uint32_t> stack;
+  for (Id id = 0; id < objects.size(); ++id) {
+    if (objects[id].leaf == none) continue;
+    const AABB &box = nodes[objects[id].leaf].box;
+    stack.assign(1, root);
+    while (!stack.empty()) {
+      const Node &node = nodes[stack.back()];
+      stack.pop_back();
+      if (!overlap(node.box, box)) continue;
+      if (node.left == none) {
+        if (node.object > id) res.emplace_back(id, node.object);
+        continue;
+      }
+      stack.push_back(node.left);
+      stack.push_back(node.right);
+    }
+  }
+  std::sort(std::begin(res), std::end(res));
+  return res;
+}
+
+std::vector<std::pair<CollisionWorld::Id, CollisionWorld::Id>>
+CollisionWorld::colliding_pairs() const {
+  std::vector<std::pair<Id, Id>> res;
+  for (const auto &p : candidate_pairs()) {
+    const Object &a = objects[p.first], &b = objects[p.second];
+    if (narrow(a.triangles, a.box, b.triangles, b.box)) res.push_back(p);
+  }
+  return res;
+}
+
+} // namespace cui3d
@@ -0,0 +1,236 @@
+#include "compositor.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace cui3d {
+
+namespace {
+
+constexpr std::size_t word_bits = 64;
+
+std::size_t word_count(const std::size_t width) {
+  return (width + word_bits - 1) / word_bits;
+}
+
+// ch in the low byte, foreground and background in 3 bits each above
+std::uint16_t pack(const Pixel &p) {
+  return static_cast<unsigned char>(p.ch)
+    | static_cast<int>(p.foreground_color) << 8
+    | static_cast<int>(p.background_color) << 11;
+}
+
+Pixel unpack(const std::uint16_t c) {
+  return Pixel(static_cast<char>(c & 0xff), static_cast<Color>(c >> 8 & 7),
+      static_cast<Color>(c >> 11 & 7));
+}
+
+// the 64 bits of a mask row starting at bit start, zero outside the row
+std::uint64_t extract(const std::uint64_t *row, const std::size_t words,
+    const long start) {
+  const long q = start >= 0 ? start / (long)word_bits
+    : -((-start + (long)word_bits - 1) / (long)word_bits);
+  const int s = start - q * (long)word_bits;
+  auto at = [&](const long k) { return k >= 0 && k < (long)words ? row[k] : 0; };
+  std::uint64_t res = at(q) >> s;
+  if (s) res |= at(q + 1) << (word_bits - s);
+  return res;
+}
+
+// grows by half again so that a terminal dragged wider does not
+// reallocate on every step; shrinking keeps the capacity
+template <typename T>
+void fit(std::vector<T> &v, const std::size_t n) {
+  if (n > v.capacity()) v.reserve(std::max(n, v.capacity() + v.capacity() / 2));
+  v.resize(n);
+}
+
+} // namespace
+
+Layer::Layer(const std::size_t height, const std::size_t width, const int z,
+    const long row, const long col)
+  : height(height), width(width), words(word_count(width)), z(z),
+    row(row), col(col), shown(true), empty(true), dirty(true),
+    shown_row(row), shown_col(col), shown_height(height), was_shown(false),
+    cells(height * words * word_bits), mask(height * words) {}
+
+void Layer::draw(const CuiImage &img, const std::size_t row, const std::size_t col) {
+  for (std::size_t i = 0; i < img.height && row + i < height; ++i) {
+    std::uint16_t *c = &cells[(row + i) * words * word_bits];
+    std::uint64_t *m = &mask[(row + i) * words];
+    for (std::size_t j = 0; j < img.width && col + j < width; ++j) {
+      if (!img.visible[i][j]) continue;
+      c[col + j] = pack(img.data[i][j]);
+      m[(col + j) / word_bits] |= std::uint64_t(1) << (col + j) % word_bits;
+      empty = false;
+    }
+  }
+  dirty = true;
+}
+
+void Layer::clear() {
+  if (empty) return;
+  std::fill(std::begin(mask), std::end(mask), 0);
+  empty = true;
+  dirty = true;
+}
+
+void Layer::resize(const std::size_t height, const std::size_t width) {
+  if (height == this->height && width == this->width) return;
+  this->height = height;
+  this->width = width;
+  words = word_count(width);
+  fit(cells, height * words * word_bits);
+  fit(mask, height * words);
+  std::fill(std::begin(mask), std::end(mask), 0);
+  empty = true;
+  dirty = true;
+}
+
+void Layer::move(const long row, const long col) {
+  if (row == this->row && col == this->col) return;
+  this->row = row;
+  this->col = col;
+  dirty = true;
+}
+
+void Layer::set_z(const int z) {
+  if (z == this->z) return;
+  this->z = z;
+  dirty = true;
+}
+
+void Layer::show(const bool shown) {
+  if (shown == this->shown) return;
+  this->shown = shown;
+  dirty = true;
+}
+
+Compositor::Compositor(const std::size_t height, const std::size_t width)
+  : height(height), width(width), words(word_count(width)),
+    cells(height * words * word_bits), mask(height * words),
+    dirty_rows(height, 1), last_changed(false), image(height, width) {}
+
+Layer &Compositor::add_layer(const std::size_t height, const std::size_t width,
+    const int z, const long row, const long col) {
+  layers.emplace_back(new Layer(height, width, z, row, col));
+  return *layers.back();
+}
+
+void Compositor::remove_layer(const Layer &layer) {
+  if (layer.was_shown) mark(layer.shown_row, layer.shown_height);
+  layers.erase(std::remove_if(std::begin(layers), std::end(layers),
+        [&layer](const std::unique_ptr<Layer> &p) { return p.get() == &layer; }),
+      std::end(layers));
+}
+
+void Compositor::resize(const std::size_t height, const std::size_t width) {
+  if (height == this->height && width == this->width) return;
+  this->height = height;
+  this->width = width;
+  words = word_count(width);
+  fit(cells, height * words * word_bits);
+  fit(mask, height * words);
+  fit(dirty_rows, height);
+  std::fill(std::begin(dirty_rows), std::end(dirty_rows), 1);
+  image.resize(height, width);
+}
+
+void Compositor::mark(const long row, const std::size_t h) {
+  const long first = std::max(0L, row);
+  const long last = std::min((long)height, row + (long)h);
+  for (long i = first; i < last; ++i) dirty_rows[i] = 1;
+}
+
+void Compositor::blend_row(const Layer &layer, const std::size_t r) {
+  const std::size_t lr = r - layer.row;
+  const std::uint64_t *lmask = &layer.mask[lr * layer.words];
+  const std::uint16_t *lcells = &layer.cells[lr * layer.words * word_bits];
+  std::uint16_t *dst_row = &cells[r * words * word_bits];
+  const long first = std::max(0L, layer.col);
+  const long last = std::min((long)width, layer.col + (long)layer.width);
+  if (first >= last) return;
+  for (std::size_t wd = first / word_bits; wd * word_bits < (std::size_t)last; ++wd) {
+    const long base = wd * word_bits;
+    std::uint64_t m = extract(lmask, layer.words, base - layer.col);
+    if (width - base < word_bits) m &= (std::uint64_t(1) << (width - base)) - 1;
+    if (!m) continue;
+    mask[r * words + wd] |= m;
+    std::uint16_t *dst = dst_row + base;
+    const long src_first = base - layer.col;
+    if (src_first >= 0 && src_first + word_bits <= layer.words * word_bits) {
+      const std::uint16_t *src = lcells + src_first;
+      if (m == ~std::uint64_t(0)) {
+        std::memcpy(dst, src, word_bits * sizeof(std::uint16_t));
+      } else {
+        // branchless select, vectorized by the compiler
+        for (std::size_t k = 0; k < word_bits; ++k) {
+          const std::uint16_t sel = -static_cast<std::uint16_t>(m >> k & 1);
+          dst[k] = (src[k] & sel) | (dst[k] & ~sel);
+        }
+      }
+    } else {
+      // the word straddles the start of the layer row
+      for (std::uint64_t b = m; b; b &= b - 1) {
+        const int k = __builtin_ctzll(b);
+        dst[k] = lcells[src_first + k];
+      }
+    }
+  }
+}
+
+const CuiImage &Compositor::compose() {
+  std::vector<const Layer *> sorted;
+  for (const auto &layer : layers) sorted.push_back(layer.get());
+  std::stable_sort(std::begin(sorted), std::end(sorted),
+      [](const Layer *a, const Layer *b) { return a->z < b->z; });
+  if (sorted != order) {
+    std::fill(std::begin(dirty_rows), std::end(dirty_rows), 1);
+    order = std::move(sorted);
+  }
+  for (const auto &p : layers) {
+    Layer &layer = *p;
+    if (!layer.dirty) continue;
+    if (layer.was_shown) mark(layer.shown_row, layer.shown_height);
+    if (layer.shown) mark(layer.row, layer.height);
+    layer.shown_row = layer.row;
+    layer.shown_col = layer.col;
+    layer.shown_height = layer.height;
+    layer.was_shown = layer.shown;
+    layer.dirty = false;
+  }
+  last_changed = false;
+  for (std::size_t r = 0; r < height; ++r) {
+    if (!dirty_rows[r]) continue;
+    dirty_rows[r] = 0;
+    last_changed = true;
+    std::fill_n(&mask[r * words], words, 0);
+    for (const Layer *layer : order)
+      if (layer->shown && !layer->empty && (long)r >= layer->row
+          && (long)r < layer->row + (long)layer->height)
+        blend_row(*layer, r);
+    const std::uint16_t *c = &cells[r * words * word_bits];
+    const std::uint64_t *m = &mask[r * words];
+    auto &data = image.data[r];
+    auto &visible = image.visible[r];
+    for (std::size_t wd = 0; wd < words; ++wd) {
+      const std::size_t base = wd * word_bits;
+      const std::size_t n = std::min(word_bits, width - base);
+      const std::uint64_t bits = m[wd];
+      // filling whole words of the bit vector avoids per-bit stores
+      if (bits == 0 || bits == ~std::uint64_t(0) >> (word_bits - n)) {
+        std::fill_n(std::begin(visible) + base, n, bits != 0);
+        if (bits)
+          for (std::size_t k = 0; k < n; ++k) data[base + k] = unpack(c[base + k]);
+        continue;
+      }
+      for (std::size_t k = 0; k < n; ++k) {
+        const bool v = bits >> k & 1;
+        visible[base + k] = v;
+        if (v) data[base + k] = unpack(c[base + k]);
+      }
+    }
+  }
+  return image;
+}
+
+} // namespace cui3d
@@ -1,10 +1,17 @@
 #include "cui3d.hpp"
+#include "compositor.hpp"
+#include "recorder.hpp"
+#include "winch.hpp"
 #include <algorithm>
 #include <iostream>
 #include <ncurses.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#undef clear
 
 namespace cui3d {
 
+
 void CuiImage::view() {
   for (std::size_t i = 0; i < height; ++i) {
     for (std::size_t j = 0; j < width; ++j) {
@@ -15,6 +22,17 @@ void CuiImage::view() {
   }
 }
 
+void CuiImage::resize(std::size_t height, std::size_t width) {
+  this->height = height;
+  this->width = width;
+  data.resize(height);
+  visible.resize(height);
+  for (std::size_t i = 0; i < height; ++i) {
+    data[i].resize(width);
+    visible[i].assign(width, false);
+  }
+}
+
 CuiImage &composite(CuiImage &lhs, const CuiImage &rhs) {
   for (std::size_t i = 0; i < std::min(lhs.height, rhs.height); ++i) {
     for (std::size_t j = 0; j < std::min(lhs.width, rhs.width); ++j) {
@@ -27,6 +45,57 @@ CuiImage &composite(CuiImage &lhs, const CuiImage &rhs) {
   return lhs;
 }
 
+CuiImage upscale(const CuiImage &img, std::size_t height, std::size_t width) {
+  CuiImage res(height, width);
+  if (img.height == 0 || img.width == 0) return res;
+  std::vector<std::size_t> cols(width);
+  for (std::size_t j = 0; j < width; ++j)
+    cols[j] = j * img.width / width;
+  for (std::size_t i = 0; i < height; ++i) {
+    std::size_t si = i * img.height / height;
+    for (std::size_t j = 0; j < width; ++j) {
+      res.data[i][j] = img.data[si][cols[j]];
+      res.visible[i][j] = img.visible[si][cols[j]];
+    }
+  }
+  return res;
+}
+
+std::vector<CellRun> diff(const CuiImage &prev, const CuiImage &next) {
+  std::vector<CellRun> res;
+  for (std::size_t i = 0; i < next.height; ++i) {
+    const bool has_prev = i < prev.height;
+    CellRun *run = nullptr;
+    for (std::size_t j = 0; j < next.width; ++j) {
+      const bool was = has_prev && j < prev.width && prev.visible[i][j];
+      const bool is = next.visible[i][j];
+      bool changed = is ? !was || prev.data[i][j] != next.data[i][j] : was;
+      if (!changed) {
+        run = nullptr;
+        continue;
+      }
+      if (!run) {
+        res.push_back(CellRun{i, j, {}, {}});
+        run = &res.back();
+      }
+      run->pixels.push_back(next.data[i][j]);
+      run->visible.push_back(is);
+    }
+  }
+  return res;
+}
+
+CuiImage &apply(CuiImage &img, const std::vector<CellRun> &runs) {
+  for (const CellRun &run : runs) {
+    if (run.row >= img.height) continue;
+    for (std::size_t k = 0; k < run.pixels.size() && run.col + k < img.width; ++k) {
+      img.data[run.row][run.col + k] = run.pixels[k];
+      img.visible[run.row][run.col + k] = run.visible[k];
+    }
+  }
+  return img;
+}
+
 bool Screen::is_init_scr = false;
 
 Screen::Screen() {
@@ -50,39 +119,94 @@ Screen::Screen() {
     assume_default_colors(COLOR_BLACK, COLOR_BLACK);
     is_init_scr = true;
   }
+  // chains to the handler initscr may have installed
+  winch.reset(new WinchSubscription());
+  winch_seen = WinchSubscription::generation();
   getmaxyx(stdscr, height, width);
   current_image = CuiImage(height, width);
-  next_image = current_image;
+  compositor.reset(new Compositor(height, width));
+  base = &compositor->add_layer(height, width, 0);
 }
 
 void Screen::draw(const CuiImage &img) {
-  composite(next_image, img);
+  base->draw(img);
+}
+
+Layer &Screen::add_layer(const std::size_t height, const std::size_t width,
+    const int z, const long row, const long col) {
+  return compositor->add_layer(height, width, z, row, col);
+}
+
+void Screen::remove_layer(const Layer &layer) {
+  compositor->remove_layer(layer);
+}
+
+void Screen::clear() {
+  // the next refresh starts from a blank terminal, so only visible cells
+  // have to be sent
+  wclear(stdscr);
+  for (auto &row : current_image.visible)
+    std::fill(std::begin(row), std::end(row), false);
+  repaint = true;
+}
+
+bool Screen::poll_resize() {
+  const unsigned long seen = WinchSubscription::generation();
+  if (seen == winch_seen) return false;
+  winch_seen = seen;
+  winsize ws;
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) < 0 || ws.ws_row == 0 || ws.ws_col == 0)
+    return false;
+  resizeterm(ws.ws_row, ws.ws_col);
+  if (ws.ws_row == height && ws.ws_col == width) return false;
+  resize(ws.ws_row, ws.ws_col);
+  clear();
+  return true;
+}
+
+void Screen::resize(const std::size_t height, const std::size_t width) {
+  this->height = height;
+  this->width = width;
+  compositor->resize(height, width);
+  base->resize(height, width);
+  current_image.resize(height, width);
 }
 
 void Screen::render() {
-  for (std::size_t i = 0; i < height; ++i) {
-    for (std::size_t j = 0; j < width; ++j) {
-      if (next_image.visible[i][j]) {
-        if (current_image.visible[i][j]
-            && next_image.data[i][j] == current_image.data[i][j]) continue;
-        move(i, j);
-        int fgclr = static_cast<int>(next_image.data[i][j].foreground_color);
-        int bgclr = static_cast<int>(next_image.data[i][j].background_color);
-        attrset(COLOR_PAIR(fgclr * 8 + bgclr));
-        addch(next_image.data[i][j].ch);
-      } else if (current_image.visible[i][j]) {
-        move(i, j);
-        attrset(COLOR_PAIR(0));
-        addch(' ');
+  poll_resize();
+  const CuiImage &next_image = compositor->compose();
+  std::vector<CellRun> runs;
+  const bool full = repaint;
+  if (compositor->changed() || full) runs = diff(current_image, next_image);
+  repaint = false;
+  int attr = -1;
+  for (const CellRun &run : runs) {
+    move(run.row, run.col);
+    for (std::size_t k = 0; k < run.pixels.size(); ++k) {
+      int pair = 0;
+      char ch = ' ';
+      if (run.visible[k]) {
+        int fgclr = static_cast<int>(run.pixels[k].foreground_color);
+        int bgclr = static_cast<int>(run.pixels[k].background_color);
+        pair = fgclr * 8 + bgclr;
+        ch = run.pixels[k].ch;
       }
+      if (pair != attr) attrset(COLOR_PAIR(pair));
+      attr = pair;
+      addch(ch);
     }
   }
   refresh();
-  current_image = std::move(next_image);
-  next_image = CuiImage(height, width);
+  // after a clear the runs start from a blank terminal, not from the
+  // frame the recorder holds
+  if (recorder && full) recorder->record(next_image);
+  else if (recorder) recorder->record(next_image, runs);
+  apply(current_image, runs);
+  base->clear();
 }
 
 Screen::~Screen() {
+  winch.reset();
   endwin();
   is_init_scr = false;
 }
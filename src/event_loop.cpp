@@ -0,0 +1,142 @@
+#include "event_loop.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace cui3d {
+
+namespace {
+
+void open_pipe(int fds[2]) {
+  if (pipe(fds) < 0) {
+    fds[0] = fds[1] = -1;
+    return;
+  }
+  for (int i = 0; i < 2; ++i) {
+    fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+  }
+}
+
+} // namespace
+
+EventLoop::EventLoop(const int fd)
+  : fd(fd), restore_termios(false), stopped(false) {
+  open_pipe(wake_pipe);
+  open_pipe(winch_pipe);
+  winch.reset(new WinchSubscription(winch_pipe[1]));
+  if (isatty(fd) && tcgetattr(fd, &saved_termios) == 0) {
+    termios raw = saved_termios;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    restore_termios = tcsetattr(fd, TCSANOW, &raw) == 0;
+  }
+  reader = std::thread(&EventLoop::read_input, this);
+}
+
+EventLoop::~EventLoop() {
+  stop();
+  reader.join();
+  winch.reset();
+  if (restore_termios) tcsetattr(fd, TCSANOW, &saved_termios);
+  for (int k = 0; k < 2; ++k) {
+    close(wake_pipe[k]);
+    close(winch_pipe[k]);
+  }
+}
+
+void EventLoop::push(const InputEvent &event) {
+  if (event.type == InputEvent::Type::RESIZE
+      && std::any_of(std::begin(pending), std::end(pending),
+        [](const InputEvent &e) { return e.type == InputEvent::Type::RESIZE; }))
+    return;
+  pending.push_back(event);
+}
+
+void EventLoop::read_input() {
+  pollfd fds[3] = {
+    {fd, POLLIN, 0},
+    {wake_pipe[0], POLLIN, 0},
+    {winch_pipe[0], POLLIN, 0}
+  };
+  char buf[256];
+  while (true) {
+    if (::poll(fds, 3, -1) < 0) {
+      if (errno == EINTR) continue;
+      std::lock_guard<std::mutex> lk(mtx);
+      push({InputEvent::Type::CLOSE, -1});
+      cv.notify_all();
+      return;
+    }
+    if (fds[1].revents) return;
+    if (fds[2].revents & POLLIN) {
+      while (read(winch_pipe[0], buf, sizeof(buf)) > 0) {}
+      std::lock_guard<std::mutex> lk(mtx);
+      push({InputEvent::Type::RESIZE, 0});
+      cv.notify_all();
+    }
+    if (fds[0].revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL)) {
+      ssize_t len = read(fd, buf, sizeof(buf));
+      if (len < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+      std::lock_guard<std::mutex> lk(mtx);
+      if (len <= 0) {
+        push({InputEvent::Type::CLOSE, -1});
+        cv.notify_all();
+        return;
+      }
+      for (ssize_t i = 0; i < len; ++i)
+        push({InputEvent::Type::KEY, static_cast<unsigned char>(buf[i])});
+      cv.notify_all();
+    }
+  }
+}
+
+std::vector<InputEvent> EventLoop::poll() {
+  std::vector<InputEvent> res;
+  std::lock_guard<std::mutex> lk(mtx);
+  res.swap(pending);
+  return res;
+}
+
+std::vector<InputEvent> EventLoop::wait() {
+  std::vector<InputEvent> res;
+  std::unique_lock<std::mutex> lk(mtx);
+  cv.wait(lk, [this] { return !pending.empty() || stopped; });
+  res.swap(pending);
+  return res;
+}
+
+std::vector<InputEvent> EventLoop::wait(const std::chrono::nanoseconds timeout) {
+  std::vector<InputEvent> res;
+  std::unique_lock<std::mutex> lk(mtx);
+  cv.wait_for(lk, timeout, [this] { return !pending.empty() || stopped; });
+  res.swap(pending);
+  return res;
+}
+
+void EventLoop::run(const Update &update, const Render &render) {
+  render();
+  while (true) {
+    auto events = wait();
+    if (events.empty()) break;
+    bool closed = std::any_of(std::begin(events), std::end(events),
+        [](const InputEvent &e) { return e.type == InputEvent::Type::CLOSE; });
+    if (update(events)) render();
+    std::lock_guard<std::mutex> lk(mtx);
+    if (closed || stopped) break;
+  }
+}
+
+void EventLoop::stop() {
+  std::lock_guard<std::mutex> lk(mtx);
+  if (stopped) return;
+  stopped = true;
+  char c = 0;
+  if (write(wake_pipe[1], &c, 1) < 0) {}
+  cv.notify_all();
+}
+
+} // namespace cui3d
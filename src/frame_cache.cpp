@@ -0,0 +1,72 @@
+#include "frame_cache.hpp"
+#include <cmath>
+#include <utility>
+
+namespace cui3d {
+
+namespace {
+
+// hash_combine followed by the splitmix64 finaliser
+std::uint64_t mix(std::uint64_t h, const std::uint64_t v) {
+  h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+} // namespace
+
+FrameKey frame_key(const std::uint64_t scene_version, const Camera &cam,
+    const std::size_t height, const std::size_t width) {
+  FrameKey key;
+  key.scene_version = scene_version;
+  for (int a = 0; a < 3; ++a) {
+    key.camera[a] = std::llround(cam.camera_pos[a] * 1e+9);
+    key.camera[3 + a] = std::llround(cam.camera_direction[a] * 1e+9);
+  }
+  key.mode = cam.mode;
+  key.height = height;
+  key.width = width;
+  std::uint64_t h = mix(0, scene_version);
+  for (std::int64_t c : key.camera) h = mix(h, c);
+  h = mix(h, static_cast<std::uint64_t>(key.mode));
+  h = mix(h, height);
+  key.hash = mix(h, width);
+  return key;
+}
+
+const CuiImage *FrameCache::find(const FrameKey &key) {
+  auto it = index.find(key.hash);
+  if (it == std::end(index) || !(it->second->key == key)) {
+    ++miss_count;
+    return nullptr;
+  }
+  ++hit_count;
+  entries.splice(std::begin(entries), entries, it->second);
+  return &it->second->frame;
+}
+
+const CuiImage &FrameCache::insert(const FrameKey &key, CuiImage frame) {
+  auto it = index.find(key.hash);
+  if (it != std::end(index)) {
+    // same hash, different state: the newer frame takes the slot
+    entries.erase(it->second);
+    index.erase(it);
+  }
+  entries.push_front(Entry{key, std::move(frame)});
+  index[key.hash] = std::begin(entries);
+  while (entries.size() > capacity) {
+    index.erase(entries.back().key.hash);
+    entries.pop_back();
+  }
+  return entries.front().frame;
+}
+
+void FrameCache::clear() {
+  entries.clear();
+  index.clear();
+}
+
+} // namespace cui3d
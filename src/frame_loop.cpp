@@ -0,0 +1,96 @@
+#include "frame_loop.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <time.h>
+
+namespace cui3d {
+
+namespace {
+
+constexpr std::int64_t nsec = 1000000000;
+
+std::int64_t now() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * nsec + ts.tv_nsec;
+}
+
+void sleep_until(const std::int64_t deadline) {
+  timespec ts = {static_cast<time_t>(deadline / nsec),
+    static_cast<long>(deadline % nsec)};
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+}
+
+} // namespace
+
+FrameLoop::FrameLoop(const std::chrono::nanoseconds frame_period,
+    const std::chrono::nanoseconds timestep, const SkipPolicy policy,
+    const std::size_t max_updates, const std::size_t history)
+  : period(std::max<std::int64_t>(1, frame_period.count())),
+    timestep(std::max<std::int64_t>(1, timestep.count())),
+    policy(policy), max_updates(max_updates), stopped(false),
+    frame_times(std::max<std::size_t>(1, history)), next_sample(0),
+    frames(0), missed(0) {}
+
+void FrameLoop::push_frame_time(const std::int64_t ns) {
+  frame_times[next_sample++ % frame_times.size()] = ns;
+}
+
+void FrameLoop::run(const Update &update, const Render &render) {
+  stopped = false;
+  std::int64_t deadline = now();
+  std::int64_t last_start = deadline;
+  std::int64_t accumulated = 0;
+  while (!stopped) {
+    sleep_until(deadline);
+    const std::int64_t start = now();
+    if (frames > 0) push_frame_time(start - last_start);
+    accumulated += start - last_start;
+    last_start = start;
+    // more steps than max_updates would only make the next frame later
+    std::size_t steps = 0;
+    while (accumulated >= timestep && steps < max_updates && !stopped) {
+      update(timestep / (double)nsec);
+      accumulated -= timestep;
+      ++steps;
+    }
+    if (accumulated >= timestep) accumulated %= timestep;
+    if (stopped) break;
+    render(accumulated / (double)timestep);
+    ++frames;
+
+    deadline += period;
+    const std::int64_t end = now();
+    if (end <= deadline) continue;
+    ++missed;
+    switch (policy) {
+      case SkipPolicy::CATCH_UP:
+        break;
+      case SkipPolicy::SKIP:
+        deadline += (end - deadline) / period * period + period;
+        break;
+      case SkipPolicy::RESYNC:
+        deadline = end;
+        break;
+    }
+  }
+}
+
+FrameStats FrameLoop::stats() const {
+  FrameStats res{frames, missed, std::chrono::nanoseconds(0),
+    std::chrono::nanoseconds(0), std::chrono::nanoseconds(0)};
+  std::size_t n = std::min(next_sample, frame_times.size());
+  if (n == 0) return res;
+  std::vector<std::int64_t> v(std::begin(frame_times), std::begin(frame_times) + n);
+  auto at = [&v](const double q) {
+    auto it = std::begin(v) + std::min(v.size() - 1, (std::size_t)(q * v.size()));
+    std::nth_element(std::begin(v), it, std::end(v));
+    return std::chrono::nanoseconds(*it);
+  };
+  res.p50 = at(0.5);
+  res.p99 = at(0.99);
+  res.worst = std::chrono::nanoseconds(*std::max_element(std::begin(v), std::end(v)));
+  return res;
+}
+
+} // namespace cui3d
@@ -0,0 +1,187 @@
+#include "frame_server.hpp"
+#include "ansi.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace cui3d {
+
+namespace {
+
+void set_flags(const int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+} // namespace
+
+FrameServer::~FrameServer() {
+  close();
+}
+
+status_t FrameServer::listen(const std::string &path) {
+  sockaddr_un addr = {};
+  if (listen_fd >= 0 || path.size() >= sizeof(addr.sun_path))
+    return status_t::UNKNOWN_ERROR;
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return status_t::IO_ERROR;
+  unlink(path.c_str());
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0
+      || ::listen(fd, 16) < 0 || pipe(wake_pipe) < 0) {
+    ::close(fd);
+    return status_t::IO_ERROR;
+  }
+  set_flags(fd);
+  set_flags(wake_pipe[0]);
+  set_flags(wake_pipe[1]);
+  listen_fd = fd;
+  this->path = path;
+  stopped = false;
+  server = std::thread(&FrameServer::serve, this);
+  return status_t::SUCCESS;
+}
+
+void FrameServer::publish(const CuiImage &img) {
+  auto next = std::make_shared<const CuiImage>(img);
+  std::lock_guard<std::mutex> lk(mtx);
+  latest = std::move(next);
+  ++latest_id;
+  char c = 0;
+  if (wake_pipe[1] >= 0 && write(wake_pipe[1], &c, 1) < 0) {}
+}
+
+void FrameServer::close() {
+  if (listen_fd < 0) return;
+  {
+    std::lock_guard<std::mutex> lk(mtx);
+    stopped = true;
+    char c = 0;
+    if (write(wake_pipe[1], &c, 1) < 0) {}
+  }
+  server.join();
+  for (Client &c : clients) ::close(c.fd);
+  clients.clear();
+  ::close(listen_fd);
+  ::close(wake_pipe[0]);
+  ::close(wake_pipe[1]);
+  listen_fd = wake_pipe[0] = wake_pipe[1] = -1;
+  unlink(path.c_str());
+  std::lock_guard<std::mutex> lk(mtx);
+  clients_connected = 0;
+}
+
+std::size_t FrameServer::client_count() const {
+  std::lock_guard<std::mutex> lk(mtx);
+  return clients_connected;
+}
+
+std::uint64_t FrameServer::skipped_frames() const {
+  std::lock_guard<std::mutex> lk(mtx);
+  return frames_skipped;
+}
+
+// false once the client is gone
+bool FrameServer::flush(Client &c, const std::uint64_t id,
+    const std::shared_ptr<const CuiImage> &img) {
+  while (c.out || (img && c.shown_id != id)) {
+    if (c.out) {
+      ssize_t len = send(c.fd, c.out->data() + c.written,
+          c.out->size() - c.written, MSG_NOSIGNAL);
+      if (len < 0) {
+        if (errno == EINTR) continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+      }
+      c.written += len;
+      if (c.written == c.out->size()) c.out.reset();
+      continue;
+    }
+    if (encoded_id != id) {
+      encoded.clear();
+      encoded_id = id;
+    }
+    // clients that saw the same frame share one encoding
+    auto it = encoded.find(c.shown_id);
+    if (it == std::end(encoded)) {
+      bool fresh = !c.shown || c.shown->height != img->height
+        || c.shown->width != img->width;
+      auto out = std::make_shared<const std::string>(fresh
+          ? to_ansi(diff(CuiImage(), *img), true)
+          : to_ansi(diff(*c.shown, *img)));
+      it = encoded.emplace(c.shown_id, std::move(out)).first;
+    }
+    if (c.shown_id != 0 && id > c.shown_id + 1) {
+      std::lock_guard<std::mutex> lk(mtx);
+      frames_skipped += id - c.shown_id - 1;
+    }
+    c.out = it->second;
+    c.written = 0;
+    c.shown = img;
+    c.shown_id = id;
+  }
+  return true;
+}
+
+void FrameServer::serve() {
+  std::vector<pollfd> fds;
+  char buf[256];
+  while (true) {
+    std::shared_ptr<const CuiImage> img;
+    std::uint64_t id;
+    {
+      std::lock_guard<std::mutex> lk(mtx);
+      if (stopped) return;
+      img = latest;
+      id = latest_id;
+    }
+    std::size_t before = clients.size();
+    clients.erase(std::remove_if(std::begin(clients), std::end(clients),
+          [&](Client &c) {
+            if (flush(c, id, img)) return false;
+            ::close(c.fd);
+            return true;
+          }), std::end(clients));
+    if (clients.size() != before) {
+      std::lock_guard<std::mutex> lk(mtx);
+      clients_connected = clients.size();
+    }
+
+    fds.clear();
+    fds.push_back({listen_fd, POLLIN, 0});
+    fds.push_back({wake_pipe[0], POLLIN, 0});
+    for (const Client &c : clients)
+      fds.push_back({c.fd, static_cast<short>(c.out ? POLLIN | POLLOUT : POLLIN), 0});
+    if (::poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR) return;
+
+    if (fds[1].revents & POLLIN)
+      while (read(wake_pipe[0], buf, sizeof(buf)) > 0) {}
+    // input from clients is not used; reading it notices hangups
+    for (std::size_t k = 0; k < clients.size(); ++k) {
+      if (!(fds[k + 2].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+      ssize_t len = read(clients[k].fd, buf, sizeof(buf));
+      if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR)) {
+        ::close(clients[k].fd);
+        clients[k].fd = -1;
+      }
+    }
+    clients.erase(std::remove_if(std::begin(clients), std::end(clients),
+          [](const Client &c) { return c.fd < 0; }), std::end(clients));
+    if (fds[0].revents & POLLIN) {
+      int fd;
+      while ((fd = accept(listen_fd, nullptr, nullptr)) >= 0) {
+        set_flags(fd);
+        clients.push_back(Client{fd, 0, nullptr, nullptr, 0});
+      }
+    }
+    std::lock_guard<std::mutex> lk(mtx);
+    clients_connected = clients.size();
+  }
+}
+
+} // namespace cui3d
@@ -1,6 +1,5 @@
 #include "geometry.hpp"
 #include <cmath>
-#include <bitset>
 
 namespace cui3d {
 
@@ -66,25 +65,21 @@ std::array<Vec3D, 3> orthonormal_basis(const Vec3D &vec) {
   return {bx, by, bz};
 }
 
-bool is_in_triangle_impl(const Triangle &tri, const Vec3D &p) {
-  std::bitset<3> bs;
-  Vec3D orthogonal = (tri[1] - tri[0]) * (tri[2] - tri[0]);
-  for (int i = 0; i < 3; ++i) {
-    auto a = tri[(i+1)%3] - tri[i], q = p - tri[i];
-    double c1 = dot(a*q, orthogonal);
-    if (std::abs(c1) < 1e-8) return false;
-    bs[i] = c1 > 0;
-  }
-  return bs.all() || bs.none();
-}
-
+// Moller-Trumbore against the infinite line through a and b
 boost::optional<Vec3D> cross(const Triangle &lhs, const Line &rhs) {
-  Vec3D p = cross(Plane(lhs), rhs);
-  if (is_in_triangle_impl(lhs, p)) {
-    return boost::optional<Vec3D>(p);
-  } else {
-    return boost::none;
-  }
+  Vec3D dir = rhs.b - rhs.a;
+  Vec3D e1 = lhs[1] - lhs[0], e2 = lhs[2] - lhs[0];
+  Vec3D pvec = dir * e2;
+  double det = dot(e1, pvec);
+  if (std::abs(det) < 1e-12) return boost::none;
+  double inv_det = 1.0 / det;
+  Vec3D tvec = rhs.a - lhs[0];
+  double u = dot(tvec, pvec) * inv_det;
+  if (u <= 0 || u >= 1) return boost::none;
+  Vec3D qvec = tvec * e1;
+  double v = dot(dir, qvec) * inv_det;
+  if (v <= 0 || u + v >= 1) return boost::none;
+  return boost::optional<Vec3D>(rhs.a + (dot(e2, qvec) * inv_det) * dir);
 }
 
 Transform3D rotateX(const double theta) {
@@ -164,8 +159,8 @@ Transform3D translateXYZ(const double distX, const double distY,
 Vec3D applyTransform(const Vec3D &vec, const Transform3D &trans) {
   Vec3D res(0, 0, 0);
   for (int i = 0; i < 3; ++i)
-    for (int j = 0; j < 4; ++j)
-      res[i] += trans[i][j] * vec[j];
+    res[i] = trans[i][0] * vec[0] + trans[i][1] * vec[1]
+      + trans[i][2] * vec[2] + trans[i][3];
   return res;
 }
 
@@ -0,0 +1,69 @@
+#include "governor.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace cui3d {
+
+namespace {
+
+constexpr double level_ratio = 0.85;
+// below this every image is a single cell anyway
+constexpr double min_scale_floor = 0.01;
+constexpr double downscale_threshold = 0.9;
+constexpr double upscale_threshold = 0.6;
+constexpr double cost_decay = 0.1;
+
+std::size_t scaled(const std::size_t size, const double scale) {
+  return std::max<std::size_t>(1, std::lround(size * scale));
+}
+
+} // namespace
+
+ResolutionGovernor::ResolutionGovernor(const std::chrono::nanoseconds budget,
+    const double min_scale, const std::size_t hold_frames)
+  : budget(budget), hold_frames(hold_frames), level(0), calm_frames(0),
+    cost(0), last_time(0) {
+  // also catches NaN
+  const double lowest = min_scale >= min_scale_floor
+    ? std::min(min_scale, 1.0) : min_scale_floor;
+  for (double s = 1.0; s > lowest; s *= level_ratio)
+    levels.push_back(s);
+  levels.push_back(lowest);
+}
+
+CuiImage ResolutionGovernor::render(const std::size_t height,
+    const std::size_t width, const Renderer &renderer) {
+  const double scale = levels[level];
+  auto start = std::chrono::steady_clock::now();
+  CuiImage img = renderer(scaled(height, scale), scaled(width, scale));
+  last_time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  // cost is the estimated full resolution render time; it follows spikes
+  // immediately and decays slowly so that one quiet frame cannot flip back
+  const double sample = last_time.count() / (scale * scale);
+  if (sample > cost) cost = sample;
+  else cost += cost_decay * (sample - cost);
+
+  const double limit = budget.count();
+  auto estimate = [&](std::size_t l) { return cost * levels[l] * levels[l]; };
+  if (estimate(level) > limit * downscale_threshold) {
+    while (level + 1 < levels.size()
+        && estimate(level) > limit * downscale_threshold)
+      ++level;
+    calm_frames = 0;
+  } else if (level > 0 && estimate(level - 1) < limit * upscale_threshold) {
+    if (++calm_frames >= hold_frames) {
+      while (level > 0 && estimate(level - 1) < limit * upscale_threshold)
+        --level;
+      calm_frames = 0;
+    }
+  } else {
+    calm_frames = 0;
+  }
+
+  if (img.height == height && img.width == width) return img;
+  return upscale(img, height, width);
+}
+
+} // namespace cui3d
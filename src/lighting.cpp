@@ -0,0 +1,41 @@
+#include "lighting.hpp"
+#include <cmath>
+
+namespace cui3d {
+
+ShadeRamp::ShadeRamp(const std::string &glyphs, const std::vector<Color> &colors,
+    const Color background) {
+  const std::string g = glyphs.empty() ? default_ramp : glyphs;
+  for (std::size_t k = 0; k < levels; ++k)
+    table[k] = Pixel(g[k * g.size() / levels],
+        colors.empty() ? Color::WHITE : colors[k * colors.size() / levels],
+        background);
+}
+
+void shade(const Lighting &lighting, const std::vector<Triangle> &triangles,
+    std::vector<Pixel> &out) {
+  const std::size_t n = triangles.size();
+  // every render thread keeps its own, so shading allocates only while
+  // they grow
+  static thread_local std::vector<Vec3D> normals;
+  static thread_local std::vector<double> intensity;
+  normals.resize(n);
+  for (std::size_t k = 0; k < n; ++k) {
+    const Triangle &tri = triangles[k];
+    Vec3D v = (tri[1] - tri[0]) * (tri[2] - tri[0]);
+    double len = std::sqrt(dot(v, v));
+    normals[k] = len > 0 ? (1.0 / len) * v : v;
+  }
+  intensity.assign(n, lighting.ambient);
+  for (const DirectionalLight &light : lighting.lights) {
+    double len = std::sqrt(dot(light.direction, light.direction));
+    if (len == 0) continue;
+    Vec3D d = (light.intensity / len) * light.direction;
+    for (std::size_t k = 0; k < n; ++k)
+      intensity[k] += std::abs(dot(normals[k], d));
+  }
+  out.resize(n);
+  for (std::size_t k = 0; k < n; ++k) out[k] = lighting.ramp(intensity[k]);
+}
+
+} // namespace cui3d
@@ -0,0 +1,292 @@
+#include "lod.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <queue>
+
+namespace cui3d {
+
+namespace {
+
+// about a cube; coarser levels stop paying off
+constexpr std::size_t min_faces = 12;
+
+// symmetric 4x4 matrix, upper triangle, summed over planes
+struct Quadric {
+  std::array<double, 10> q;
+  Quadric() { q.fill(0); }
+  Quadric(const Vec3D &n, const double d)
+    : q{{n[0]*n[0], n[0]*n[1], n[0]*n[2], n[0]*d,
+      n[1]*n[1], n[1]*n[2], n[1]*d,
+      n[2]*n[2], n[2]*d,
+      d*d}} {}
+  Quadric &operator+=(const Quadric &rhs) {
+    for (int i = 0; i < 10; ++i) q[i] += rhs.q[i];
+    return *this;
+  }
+  // sum of squared distances from v to the planes, so never less than
+  // the squared distance to any one of them
+  double operator()(const Vec3D &v) const {
+    const double x = v[0], y = v[1], z = v[2];
+    return q[0]*x*x + 2*q[1]*x*y + 2*q[2]*x*z + 2*q[3]*x
+      + q[4]*y*y + 2*q[5]*y*z + 2*q[6]*y
+      + q[7]*z*z + 2*q[8]*z
+      + q[9];
+  }
+};
+
+struct Collapse {
+  double cost;
+  std::uint32_t a, b;
+  std::uint32_t version_a, version_b;
+  Vec3D pos;
+};
+
+bool operator<(const Collapse &lhs, const Collapse &rhs) {
+  return lhs.cost > rhs.cost;
+}
+
+class Decimator {
+ public:
+  explicit Decimator(const Mesh &);
+  double run(const std::size_t target, const double max_error);
+  Mesh result() const;
+ private:
+  void push(const std::uint32_t a, const std::uint32_t b);
+  bool flips(const std::uint32_t v, const std::uint32_t other, const Vec3D &pos) const;
+  void collapse(const Collapse &);
+  std::vector<Vec3D> vertices;
+  std::vector<Mesh::Face> faces;
+  std::vector<bool> face_alive;
+  std::vector<bool> vertex_alive;
+  std::vector<std::uint32_t> version;
+  std::vector<std::vector<std::uint32_t>> vertex_faces;
+  std::vector<Quadric> quadrics;
+  std::priority_queue<Collapse> heap;
+  std::size_t alive_faces;
+};
+
+Decimator::Decimator(const Mesh &mesh)
+  : vertices(mesh.vertices), faces(mesh.faces),
+    face_alive(mesh.faces.size(), true),
+    vertex_alive(mesh.vertices.size(), true),
+    version(mesh.vertices.size(), 0),
+    vertex_faces(mesh.vertices.size()),
+    quadrics(mesh.vertices.size()),
+    alive_faces(mesh.faces.size()) {
+  for (std::uint32_t f = 0; f < faces.size(); ++f) {
+    const Mesh::Face &face = faces[f];
+    // a face repeating a vertex has no edges worth collapsing
+    if (face[0] == face[1] || face[1] == face[2] || face[2] == face[0]) {
+      face_alive[f] = false;
+      --alive_faces;
+      continue;
+    }
+    Vec3D n = (vertices[face[1]] - vertices[face[0]])
+      * (vertices[face[2]] - vertices[face[0]]);
+    double len = abs(n);
+    Quadric plane;
+    if (len > 0) {
+      n = (1.0 / len) * n;
+      plane = Quadric(n, -dot(n, vertices[face[0]]));
+    }
+    for (std::uint32_t v : face) {
+      quadrics[v] += plane;
+      vertex_faces[v].push_back(f);
+    }
+  }
+  for (std::uint32_t f = 0; f < faces.size(); ++f) {
+    if (!face_alive[f]) continue;
+    const Mesh::Face &face = faces[f];
+    for (int k = 0; k < 3; ++k)
+      if (face[k] < face[(k+1)%3]) push(face[k], face[(k+1)%3]);
+      else push(face[(k+1)%3], face[k]);
+  }
+}
+
+void Decimator::push(const std::uint32_t a, const std::uint32_t b) {
+  if (a == b) return;
+  Quadric q = quadrics[a];
+  q += quadrics[b];
+  std::array<Vec3D, 3> candidates = {
+    vertices[a], vertices[b], 0.5 * (vertices[a] + vertices[b])
+  };
+  Collapse c{std::numeric_limits<double>::infinity(), a, b,
+    version[a], version[b], vertices[a]};
+  for (const Vec3D &pos : candidates) {
+    double cost = std::max(0.0, q(pos));
+    if (cost < c.cost) {
+      c.cost = cost;
+      c.pos = pos;
+    }
+  }
+  heap.push(c);
+}
+
+// moving v to pos must not turn any surviving face around
+bool Decimator::flips(const std::uint32_t v, const std::uint32_t other,
+    const Vec3D &pos) const {
+  for (std::uint32_t f : vertex_faces[v]) {
+    if (!face_alive[f]) continue;
+    const Mesh::Face &face = faces[f];
+    if (face[0] == other || face[1] == other || face[2] == other) continue;
+    std::array<Vec3D, 3> p;
+    for (int k = 0; k < 3; ++k) p[k] = vertices[face[k]];
+    Vec3D before = (p[1] - p[0]) * (p[2] - p[0]);
+    if (dot(before, before) == 0) continue;
+    for (int k = 0; k < 3; ++k) if (face[k] == v) p[k] = pos;
+    Vec3D after = (p[1] - p[0]) * (p[2] - p[0]);
+    if (dot(before, after) <= 0) return true;
+  }
+  return false;
+}
+
+void Decimator::collapse(const Collapse &c) {
+  vertices[c.a] = c.pos;
+  quadrics[c.a] += quadrics[c.b];
+  vertex_alive[c.b] = false;
+  ++version[c.a];
+  ++version[c.b];
+  for (std::uint32_t f : vertex_faces[c.b]) {
+    if (!face_alive[f]) continue;
+    Mesh::Face &face = faces[f];
+    if (face[0] == c.a || face[1] == c.a || face[2] == c.a) {
+      face_alive[f] = false;
+      --alive_faces;
+      continue;
+    }
+    for (std::uint32_t &v : face) if (v == c.b) v = c.a;
+    vertex_faces[c.a].push_back(f);
+  }
+  vertex_faces[c.b].clear();
+  auto &vf = vertex_faces[c.a];
+  vf.erase(std::remove_if(std::begin(vf), std::end(vf),
+        [this](std::uint32_t f) { return !face_alive[f]; }), std::end(vf));
+  std::vector<std::uint32_t> neighbors;
+  for (std::uint32_t f : vf)
+    for (std::uint32_t v : faces[f])
+      if (v != c.a) neighbors.push_back(v);
+  std::sort(std::begin(neighbors), std::end(neighbors));
+  neighbors.erase(std::unique(std::begin(neighbors), std::end(neighbors)),
+      std::end(neighbors));
+  for (std::uint32_t v : neighbors) push(std::min(c.a, v), std::max(c.a, v));
+}
+
+double Decimator::run(const std::size_t target, const double max_error) {
+  double error = 0;
+  const double max_cost = max_error * max_error;
+  while (alive_faces > target && !heap.empty()) {
+    Collapse c = heap.top();
+    heap.pop();
+    if (!vertex_alive[c.a] || !vertex_alive[c.b]
+        || version[c.a] != c.version_a || version[c.b] != c.version_b)
+      continue;
+    if (c.cost > max_cost) break;
+    if (flips(c.a, c.b, c.pos) || flips(c.b, c.a, c.pos)) continue;
+    collapse(c);
+    error = std::max(error, std::sqrt(c.cost));
+  }
+  return error;
+}
+
+Mesh Decimator::result() const {
+  Mesh res;
+  std::vector<std::uint32_t> remap(vertices.size());
+  for (std::uint32_t v = 0; v < vertices.size(); ++v) {
+    if (!vertex_alive[v] || vertex_faces[v].empty()) continue;
+    remap[v] = res.vertices.size();
+    res.vertices.push_back(vertices[v]);
+  }
+  for (std::uint32_t f = 0; f < faces.size(); ++f) {
+    if (!face_alive[f]) continue;
+    res.faces.push_back(Mesh::Face{{remap[faces[f][0]],
+        remap[faces[f][1]], remap[faces[f][2]]}});
+  }
+  return res;
+}
+
+void bounding_sphere(LODPolygon &lod) {
+  Vec3D lower(0, 0, 0), upper(0, 0, 0);
+  bool first = true;
+  for (const Triangle &tri : lod.levels[0].triangles) {
+    for (const Vec3D &v : tri.verticies) {
+      for (int a = 0; a < 3; ++a) {
+        lower[a] = first ? v[a] : std::min(lower[a], v[a]);
+        upper[a] = first ? v[a] : std::max(upper[a], v[a]);
+      }
+      first = false;
+    }
+  }
+  lod.center = 0.5 * (lower + upper);
+  lod.radius = 0.5 * abs(upper - lower);
+}
+
+} // namespace
+
+Mesh decimate(const Mesh &mesh, const std::size_t target,
+    const double max_error, double *error) {
+  Decimator d(mesh);
+  double e = d.run(target, max_error);
+  if (error) *error = e;
+  return d.result();
+}
+
+LODPolygon make_lod(const Mesh &mesh, const Texture &texture,
+    const std::size_t level_count, const double ratio) {
+  LODPolygon res;
+  Mesh level = mesh;
+  double error = 0;
+  for (std::size_t k = 0; k < level_count; ++k) {
+    if (k > 0) {
+      double e;
+      std::size_t target = level.faces.size() * ratio;
+      if (target < min_faces) break;
+      Mesh next = decimate(level, target,
+          std::numeric_limits<double>::infinity(), &e);
+      if (next.faces.size() == level.faces.size()) break;
+      level = std::move(next);
+      error += e;
+    }
+    res.levels.push_back(to_polygon(level));
+    res.levels.back().texture = texture;
+    res.errors.push_back(error);
+  }
+  bounding_sphere(res);
+  return res;
+}
+
+LODPolygon applyTransform(const LODPolygon &lod, const Transform3D &trans) {
+  LODPolygon res;
+  res.errors = lod.errors;
+  for (const Polygon &level : lod.levels)
+    res.levels.push_back(applyTransform(level, trans));
+  // errors scale with the largest axis stretch of the transform
+  double stretch = 0;
+  for (int c = 0; c < 3; ++c)
+    stretch = std::max(stretch, abs(Vec3D(trans[0][c], trans[1][c], trans[2][c])));
+  for (double &e : res.errors) e *= stretch;
+  bounding_sphere(res);
+  return res;
+}
+
+const Polygon &select_level(const Camera &camera, const LODPolygon &lod,
+    const std::size_t height, const std::size_t width, const double threshold) {
+  const double len = abs(camera.camera_direction);
+  const double dist = dot(lod.center - camera.camera_pos,
+      (1.0 / len) * camera.camera_direction) - lod.radius;
+  if (dist <= 0) return lod.levels.front();
+  // cells covered by one world unit at the nearest point of the object
+  const double cells = std::max(width / len, height * len) / dist;
+  std::size_t k = 0;
+  while (k + 1 < lod.levels.size() && lod.errors[k + 1] * cells < threshold) ++k;
+  return lod.levels[k];
+}
+
+CuiImage Camera::render(CuiImage &img, const std::vector<LODPolygon> &vl) const {
+  std::vector<const Polygon *> vp;
+  for (const LODPolygon &lod : vl)
+    vp.push_back(&select_level(*this, lod, img.height, img.width));
+  return render(img, vp);
+}
+
+} // namespace cui3d
@@ -0,0 +1,58 @@
+#include "mapped_file.hpp"
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cui3d {
+
+MappedFile::MappedFile(MappedFile &&other)
+  : ptr(other.ptr), length(other.length) {
+  other.ptr = nullptr;
+  other.length = 0;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) {
+  if (this != &other) {
+    close();
+    std::swap(ptr, other.ptr);
+    std::swap(length, other.length);
+  }
+  return *this;
+}
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+status_t MappedFile::open(const std::string &path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return status_t::IO_ERROR;
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    ::close(fd);
+    return status_t::IO_ERROR;
+  }
+  length = st.st_size;
+  if (length > 0) {
+    void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      ::close(fd);
+      length = 0;
+      return status_t::IO_ERROR;
+    }
+    ptr = p;
+  }
+  ::close(fd);
+  return status_t::SUCCESS;
+}
+
+void MappedFile::close() {
+  if (ptr) munmap(ptr, length);
+  ptr = nullptr;
+  length = 0;
+}
+
+} // namespace cui3d
@@ -0,0 +1,282 @@
+#include "mesh.hpp"
+#include <cmath>
+#include <cstring>
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+
+namespace cui3d {
+
+namespace {
+
+bool is_space(const char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool is_digit(const char c) {
+  return c >= '0' && c <= '9';
+}
+
+const char *skip_space(const char *p, const char *end) {
+  while (p < end && is_space(*p)) ++p;
+  return p;
+}
+
+// a record ends at the newline or at a trailing comment
+bool in_record(const char *p, const char *end) {
+  return p < end && *p != '\n' && *p != '#';
+}
+
+const char *skip_token(const char *p, const char *end) {
+  while (in_record(p, end) && !is_space(*p)) ++p;
+  return p;
+}
+
+const char *next_line(const char *p, const char *end) {
+  auto q = static_cast<const char *>(std::memchr(p, '\n', end - p));
+  return q ? q + 1 : end;
+}
+
+double pow10(const int exp) {
+  static const double table[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  if (exp >= 0 && exp <= 22) return table[exp];
+  return std::pow(10.0, exp);
+}
+
+// bounded by end: the mapping is not NUL terminated
+bool parse_double(const char *&p, const char *end, double &res) {
+  const char *q = p;
+  bool neg = false;
+  if (q < end && (*q == '-' || *q == '+')) neg = *q++ == '-';
+  std::uint64_t mantissa = 0;
+  int digits = 0, exp = 0;
+  bool any = false;
+  auto digit = [&](const int d, const bool frac) {
+    any = true;
+    if (mantissa == 0 && d == 0) {
+      if (frac) --exp;
+    } else if (digits < 19) {
+      mantissa = mantissa * 10 + d;
+      ++digits;
+      if (frac) --exp;
+    } else if (!frac) {
+      ++exp;
+    }
+  };
+  for (; q < end && is_digit(*q); ++q) digit(*q - '0', false);
+  if (q < end && *q == '.')
+    for (++q; q < end && is_digit(*q); ++q) digit(*q - '0', true);
+  if (!any) return false;
+  if (q < end && (*q == 'e' || *q == 'E')) {
+    const char *e = q + 1;
+    bool eneg = false;
+    if (e < end && (*e == '-' || *e == '+')) eneg = *e++ == '-';
+    if (e < end && is_digit(*e)) {
+      int val = 0;
+      for (; e < end && is_digit(*e); ++e)
+        if (val < 10000) val = val * 10 + (*e - '0');
+      exp += eneg ? -val : val;
+      q = e;
+    }
+  }
+  double v = mantissa;
+  if (exp < 0) v /= pow10(-exp);
+  else if (exp > 0) v *= pow10(exp);
+  res = neg ? -v : v;
+  p = q;
+  return true;
+}
+
+bool parse_index(const char *&p, const char *end, long &res) {
+  const char *q = p;
+  bool neg = false;
+  if (q < end && (*q == '-' || *q == '+')) neg = *q++ == '-';
+  if (q >= end || !is_digit(*q)) return false;
+  long v = 0;
+  for (; q < end && is_digit(*q); ++q) v = v * 10 + (*q - '0');
+  res = neg ? -v : v;
+  p = skip_token(q, end);
+  return true;
+}
+
+enum class Record {
+  VERTEX,
+  FACE,
+  OTHER
+};
+
+Record record_type(const char *&p, const char *end) {
+  p = skip_space(p, end);
+  if (end - p >= 2 && is_space(p[1])) {
+    if (p[0] == 'v') {
+      p += 2;
+      return Record::VERTEX;
+    }
+    if (p[0] == 'f') {
+      p += 2;
+      return Record::FACE;
+    }
+  }
+  return Record::OTHER;
+}
+
+struct ObjChunk {
+  const char *begin;
+  const char *end;
+  std::size_t vertices;
+  std::size_t faces;
+  status_t status;
+};
+
+void count_obj(ObjChunk &chunk) {
+  chunk.vertices = chunk.faces = 0;
+  for (const char *line = chunk.begin; line < chunk.end;
+      line = next_line(line, chunk.end)) {
+    const char *p = line;
+    switch (record_type(p, chunk.end)) {
+     case Record::VERTEX:
+      ++chunk.vertices;
+      break;
+     case Record::FACE: {
+      std::size_t n = 0;
+      for (p = skip_space(p, chunk.end); in_record(p, chunk.end);
+          p = skip_space(skip_token(p, chunk.end), chunk.end))
+        ++n;
+      if (n >= 3) chunk.faces += n - 2;
+      break;
+     }
+     case Record::OTHER:
+      break;
+    }
+  }
+}
+
+void parse_obj(ObjChunk &chunk, std::size_t vertex_base,
+    std::size_t face_base, Mesh &mesh) {
+  const std::size_t vertex_count = mesh.vertices.size();
+  for (const char *line = chunk.begin; line < chunk.end;
+      line = next_line(line, chunk.end)) {
+    const char *p = line;
+    switch (record_type(p, chunk.end)) {
+     case Record::VERTEX: {
+      Vec3D &v = mesh.vertices[vertex_base++];
+      for (int i = 0; i < 3; ++i) {
+        p = skip_space(p, chunk.end);
+        if (!parse_double(p, chunk.end, v[i])) {
+          chunk.status = status_t::PARSE_ERROR;
+          return;
+        }
+      }
+      break;
+     }
+     case Record::FACE: {
+      std::uint32_t first = 0, prev = 0;
+      std::size_t n = 0;
+      for (p = skip_space(p, chunk.end); in_record(p, chunk.end);
+          p = skip_space(p, chunk.end), ++n) {
+        long index;
+        if (!parse_index(p, chunk.end, index) || index == 0) {
+          chunk.status = status_t::PARSE_ERROR;
+          return;
+        }
+        long resolved = index > 0 ? index - 1 : (long)vertex_base + index;
+        if (resolved < 0 || (std::size_t)resolved >= vertex_count) {
+          chunk.status = status_t::PARSE_ERROR;
+          return;
+        }
+        std::uint32_t cur = resolved;
+        if (n == 0) first = cur;
+        else if (n >= 2) mesh.faces[face_base++] = Mesh::Face{{first, prev, cur}};
+        prev = cur;
+      }
+      break;
+     }
+     case Record::OTHER:
+      break;
+    }
+  }
+}
+
+} // namespace
+
+Polygon to_polygon(const Mesh &mesh) {
+  Polygon res;
+  res.triangles.resize(mesh.faces.size());
+  parallel_for(mesh.faces.size(),
+      [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+          const Mesh::Face &f = mesh.faces[i];
+          res.triangles[i] = Triangle(mesh.vertices[f[0]],
+              mesh.vertices[f[1]], mesh.vertices[f[2]]);
+        }
+      });
+  return res;
+}
+
+status_t load_obj(const std::string &path, Mesh &mesh) {
+  MappedFile file;
+  status_t st = file.open(path);
+  if (st != status_t::SUCCESS) return st;
+  const char *data = file.data();
+  const char *end = data + file.size();
+
+  // chunks start right after a newline so every record is whole
+  const std::size_t n = file.size() ? worker_count() * 4 : 0;
+  std::vector<ObjChunk> chunks(n);
+  const char *prev = data;
+  for (std::size_t k = 0; k < n; ++k) {
+    const char *e = k + 1 == n ? end
+      : std::max(prev, data + file.size() * (k + 1) / n);
+    if (e != end) e = next_line(e, end);
+    chunks[k] = ObjChunk{prev, e, 0, 0, status_t::SUCCESS};
+    prev = e;
+  }
+  parallel_for(n, [&](std::size_t first, std::size_t last, std::size_t) {
+        for (std::size_t k = first; k < last; ++k) count_obj(chunks[k]);
+      });
+
+  std::vector<std::size_t> vertex_base(n + 1, 0), face_base(n + 1, 0);
+  for (std::size_t k = 0; k < n; ++k) {
+    vertex_base[k + 1] = vertex_base[k] + chunks[k].vertices;
+    face_base[k + 1] = face_base[k] + chunks[k].faces;
+  }
+  mesh.vertices.resize(vertex_base[n]);
+  mesh.faces.resize(face_base[n]);
+  parallel_for(n, [&](std::size_t first, std::size_t last, std::size_t) {
+        for (std::size_t k = first; k < last; ++k)
+          parse_obj(chunks[k], vertex_base[k], face_base[k], mesh);
+      });
+  for (const ObjChunk &chunk : chunks)
+    if (chunk.status != status_t::SUCCESS) return chunk.status;
+  return status_t::SUCCESS;
+}
+
+status_t load_stl(const std::string &path, Mesh &mesh) {
+  constexpr std::size_t header_size = 84, record_size = 50;
+  MappedFile file;
+  status_t st = file.open(path);
+  if (st != status_t::SUCCESS) return st;
+  if (file.size() < header_size) return status_t::PARSE_ERROR;
+  std::uint32_t count;
+  std::memcpy(&count, file.data() + 80, sizeof(count));
+  if (file.size() != header_size + record_size * count)
+    return status_t::PARSE_ERROR;
+  mesh.vertices.resize(3 * std::size_t(count));
+  mesh.faces.resize(count);
+  parallel_for(count, [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+          // normal, then three vertices, as little endian floats
+          float f[12];
+          std::memcpy(f, file.data() + header_size + record_size * i, sizeof(f));
+          for (std::size_t k = 0; k < 3; ++k)
+            mesh.vertices[3 * i + k] = Vec3D(f[3 + 3 * k], f[4 + 3 * k], f[5 + 3 * k]);
+          mesh.faces[i] = Mesh::Face{{std::uint32_t(3 * i),
+            std::uint32_t(3 * i + 1), std::uint32_t(3 * i + 2)}};
+        }
+      });
+  return status_t::SUCCESS;
+}
+
+} // namespace cui3d
@@ -0,0 +1,137 @@
+#include "particles.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "parallel.hpp"
+
+namespace cui3d {
+
+namespace {
+
+// below this a worker costs more to start than it saves
+constexpr std::size_t min_batch = 4096;
+constexpr std::uint64_t no_particle = std::numeric_limits<std::uint64_t>::max();
+
+std::size_t workers_for(const std::size_t n) {
+  return std::min(worker_count(), n / min_batch + 1);
+}
+
+// positive floats order like their bits
+std::uint64_t depth_key(const float z, const std::size_t index) {
+  std::uint32_t bits;
+  std::memcpy(&bits, &z, sizeof(bits));
+  return (std::uint64_t)bits << 32 | index;
+}
+
+} // namespace
+
+ParticleSystem::ParticleSystem(const std::size_t capacity)
+  : glyphs{Pixel('.', Color::WHITE, Color::BLACK)}, count(0),
+    x(capacity), y(capacity), z(capacity), vx(capacity), vy(capacity),
+    vz(capacity), age(capacity), lifetime(capacity) {}
+
+bool ParticleSystem::emit(const Vec3D &pos, const Vec3D &velocity,
+    const double life) {
+  // the glyph is picked by age / lifetime
+  if (count == capacity() || !(life > 0)) return false;
+  x[count] = pos[0];
+  y[count] = pos[1];
+  z[count] = pos[2];
+  vx[count] = velocity[0];
+  vy[count] = velocity[1];
+  vz[count] = velocity[2];
+  age[count] = 0;
+  lifetime[count] = life;
+  ++count;
+  return true;
+}
+
+void ParticleSystem::update(const double dt, const Vec3D &gravity) {
+  const float t = dt, gx = gravity[0] * dt, gy = gravity[1] * dt, gz = gravity[2] * dt;
+  parallel_for(count, workers_for(count),
+      [&](std::size_t first, std::size_t last, std::size_t) {
+        float *__restrict px = x.data(), *__restrict py = y.data(),
+          *__restrict pz = z.data(), *__restrict pvx = vx.data(),
+          *__restrict pvy = vy.data(), *__restrict pvz = vz.data(),
+          *__restrict pa = age.data();
+        for (std::size_t i = first; i < last; ++i) {
+          pvx[i] += gx;
+          pvy[i] += gy;
+          pvz[i] += gz;
+          px[i] += pvx[i] * t;
+          py[i] += pvy[i] * t;
+          pz[i] += pvz[i] * t;
+          pa[i] += t;
+        }
+      });
+  // the last particle takes the place of a dead one
+  for (std::size_t i = 0; i < count;) {
+    if (age[i] < lifetime[i]) {
+      ++i;
+      continue;
+    }
+    --count;
+    x[i] = x[count];
+    y[i] = y[count];
+    z[i] = z[count];
+    vx[i] = vx[count];
+    vy[i] = vy[count];
+    vz[i] = vz[count];
+    age[i] = age[count];
+    lifetime[i] = lifetime[count];
+  }
+}
+
+CuiImage ParticleSystem::render(const Camera &cam, CuiImage &img,
+    const DepthBuffer *depth) {
+  const std::size_t h = img.height, w = img.width;
+  if (depth && (depth->height != h || depth->width != w)) depth = nullptr;
+  if (glyphs.empty() || h == 0 || w == 0) return img;
+  const std::array<Vec3D, 3> basis = orthonormal_basis(cam.camera_direction);
+  const Vec3D &dir = cam.camera_direction;
+  const double scale = dot(dir, dir);
+  const float ox = cam.camera_pos[0], oy = cam.camera_pos[1], oz = cam.camera_pos[2];
+  const float ax = basis[0][0], ay = basis[0][1], az = basis[0][2];
+  const float bx = basis[1][0] * scale, by = basis[1][1] * scale, bz = basis[1][2] * scale;
+  const float cx = dir[0], cy = dir[1], cz = dir[2];
+  const std::size_t th = workers_for(count);
+  nearest.resize(th);
+  parallel_for(count, th, [&](std::size_t first, std::size_t last, std::size_t t) {
+        std::vector<std::uint64_t> &cells = nearest[t];
+        cells.assign(h * w, no_particle);
+        for (std::size_t i = first; i < last; ++i) {
+          const float dx = x[i] - ox, dy = y[i] - oy, dz = z[i] - oz;
+          const float d = dx * cx + dy * cy + dz * cz;
+          if (d <= 0) continue;
+          const float sx = (dx * ax + dy * ay + dz * az) / d;
+          const float sy = (dx * bx + dy * by + dz * bz) / d;
+          // columns cover [j / w, (j + 1) / w), rows sample at i / h
+          const float col = std::floor((sx + 0.5f) * w);
+          const float row = std::floor((sy + 0.5f) * h + 0.5f);
+          if (col < 0 || col >= w || row < 0 || row >= h) continue;
+          const std::size_t cell = (std::size_t)row * w + (std::size_t)col;
+          if (depth && d >= depth->depth[cell]) continue;
+          cells[cell] = std::min(cells[cell], depth_key(d, i));
+        }
+      });
+  // a row at a time, the visible bits of a row share words
+  parallel_for(h, workers_for(count), [&](std::size_t first, std::size_t last, std::size_t) {
+        for (std::size_t r = first; r < last; ++r) {
+          for (std::size_t j = 0; j < w; ++j) {
+            std::uint64_t key = no_particle;
+            for (const auto &cells : nearest) key = std::min(key, cells[r * w + j]);
+            if (key == no_particle) continue;
+            const std::size_t i = key & 0xffffffff;
+            const std::size_t g = std::min<std::size_t>(glyphs.size() - 1,
+                age[i] / lifetime[i] * glyphs.size());
+            img.data[r][j] = glyphs[g];
+            img.visible[r][j] = true;
+          }
+        }
+      });
+  return img;
+}
+
+} // namespace cui3d
@@ -1,11 +1,11 @@
 #include "polygon.hpp"
+#include <algorithm>
 #include <cmath>
 #include <bitset>
-#include <complex>
-#include <future>
-#include <thread>
-#include <iostream>
-#include <boost/optional.hpp>
+#include <cstdint>
+#include <utility>
+#include "instancing.hpp"
+#include "parallel.hpp"
 
 namespace cui3d {
 
@@ -34,100 +34,818 @@ Polygon make_cuboid(const Vec3D &begin, const Vec3D &end) {
 Polygon applyTransform(const Polygon &p, const Transform3D &trans) {
   Polygon res;
   res.texture = p.texture;
+  res.lighting = p.lighting;
+  res.uvs = p.uvs;
+  res.uv_texture = p.uv_texture;
   for (const auto &tri : p.triangles)
     res.triangles.emplace_back(applyTransform(tri, trans));
   return res;
 }
 
-using P = std::complex<double>;
-using VP = std::vector<P>;
-using VVP = std::vector<VP>;
+void map_uvs(Polygon &poly, const PlaneMappingTexture &texture) {
+  poly.uvs.clear();
+  for (const Triangle &tri : poly.triangles)
+    poly.uvs.push_back({{texture.map(tri[0]), texture.map(tri[1]),
+        texture.map(tri[2])}});
+  poly.uv_texture = texture;
+}
+
+namespace {
+
+// Camera space is (X, Y * L^2, z) where X and Y are along the screen axes
+// and z = dot(p - camera_pos, camera_direction), L = |camera_direction|.
+// Screen coordinates are then simply (v[0] / z, v[1] / z).
+struct Projection {
+  Vec3D pos;
+  Vec3D direction;
+  std::array<Vec3D, 3> basis;
+  double scale;
+  explicit Projection(const Camera &c)
+    : pos(c.camera_pos), direction(c.camera_direction),
+      basis(orthonormal_basis(c.camera_direction)),
+      scale(dot(c.camera_direction, c.camera_direction)) {}
+  Vec3D operator()(const Vec3D &p) const {
+    Vec3D d = p - pos;
+    return Vec3D(dot(d, basis[0]), dot(d, basis[1]) * scale, dot(d, direction));
+  }
+  Vec3D world(const double x, const double y, const double z) const {
+    return pos + z * direction + (z * x) * basis[0] + (z * y) * basis[1];
+  }
+};
+
+constexpr double near_z = 1e-9;
+
+// geometry shared by every viewport of a frame
+// an instance is expanded to world space only when projected
+struct WorldItem {
+  const Polygon *poly;
+  const Transform3D *transform;
+  TextureRef texture;
+  Vec3D lower, upper;
+};
+
+// The fill loop is instantiated for each material, so the texture
+// lookup is inlined into it; FUNCTION calls through the std::function.
+enum class Material : std::uint8_t { FUNCTION, SHADE, FILL, PLANE };
+
+// texture coordinates of a plane mapping as seen from one camera:
+// u = u[0] + z * (u[1] + x * u[2] + y * u[3]) at screen (x, y) and depth z,
+// likewise v
+struct PlaneSpan {
+  std::array<double, 4> u, v;
+  const PlaneMappingTexture *texture;
+};
+
+struct ProjectedTriangle {
+  std::array<Vec3D, 3> v;
+  const Polygon *poly;
+  // for Material::FUNCTION
+  const Texture *texture;
+  // for Material::SHADE and Material::FILL
+  Pixel pixel;
+  const std::array<TexCoord, 3> *uv;
+  Material material;
+  std::uint32_t plane;
+};
+
+struct ViewState {
+  const Viewport *view;
+  Projection proj;
+  std::vector<ProjectedTriangle> triangles;
+  std::vector<PlaneSpan> planes;
+  std::vector<std::vector<std::uint32_t>> bins;
+  // world triangles of one lit object that survived culling, shaded
+  // together once the object is projected
+  std::vector<Triangle> lit;
+  std::vector<std::uint32_t> lit_index;
+  std::vector<Pixel> lit_shades;
+  ViewState(const Viewport &view)
+    : view(&view), proj(view.camera), bins(view.height) {}
+};
 
-bool is_on_segment(const Vec3D &p, const Line &l) {
-  return abs(l.a-l.b) + 1e-8 > abs(p-l.a) + abs(p-l.b);
+void bounds(const std::vector<Triangle> &triangles, Vec3D &lower, Vec3D &upper) {
+  lower = upper = Vec3D(0, 0, 0);
+  bool init = false;
+  for (const Triangle &tri : triangles)
+    for (const Vec3D &v : tri.verticies)
+      for (int a = 0; a < 3; ++a) {
+        lower[a] = init ? std::min(lower[a], v[a]) : v[a];
+        upper[a] = init ? std::max(upper[a], v[a]) : v[a];
+        init = true;
+      }
+}
+
+// a texture behind a std::function; the types known here are recovered
+// once per object so that they take the same paths as in
+// Camera::render<T>
+TextureRef resolve(const Texture &texture) {
+  if (const auto *fill = texture.target<FillfullTexture>()) return fill;
+  if (const auto *plane = texture.target<PlaneMappingTexture>()) return plane;
+  return &texture;
+}
+
+// with texture set, every object is drawn with it instead of its own
+std::vector<WorldItem> gather(const std::vector<const Polygon *> &vp,
+    const std::vector<const InstancedPolygon *> &vi, const TextureRef *texture) {
+  std::vector<WorldItem> res;
+  for (const Polygon *poly : vp)
+    res.push_back(WorldItem{poly, nullptr,
+        texture ? *texture : resolve(poly->texture),
+        Vec3D(0, 0, 0), Vec3D(0, 0, 0)});
+  // mesh bounds once, instances transform their corners below
+  for (const InstancedPolygon *ip : vi) {
+    Vec3D lower, upper;
+    bounds(ip->mesh->triangles, lower, upper);
+    for (const Instance &inst : ip->instances)
+      res.push_back(WorldItem{ip->mesh.get(), &inst.transform,
+          texture ? *texture
+            : resolve(inst.texture ? inst.texture : ip->mesh->texture),
+          lower, upper});
+  }
+  parallel_for(res.size(), [&](std::size_t first, std::size_t last, std::size_t) {
+        for (std::size_t k = first; k < last; ++k) {
+          WorldItem &item = res[k];
+          if (!item.transform) {
+            bounds(item.poly->triangles, item.lower, item.upper);
+            continue;
+          }
+          const Vec3D lo = item.lower, hi = item.upper;
+          for (int c = 0; c < 8; ++c) {
+            Vec3D v = applyTransform(Vec3D(c & 1 ? hi[0] : lo[0],
+                  c & 2 ? hi[1] : lo[1], c & 4 ? hi[2] : lo[2]), *item.transform);
+            for (int a = 0; a < 3; ++a) {
+              item.lower[a] = c ? std::min(item.lower[a], v[a]) : v[a];
+              item.upper[a] = c ? std::max(item.upper[a], v[a]) : v[a];
+            }
+          }
+        }
+      });
+  return res;
+}
+
+// conservative: false only if nothing inside the box can reach the screen
+bool may_be_visible(const Projection &proj, const Vec3D &lower, const Vec3D &upper) {
+  double min_x = 1, max_x = -1, min_y = 1, max_y = -1;
+  for (int i = 0; i < 8; ++i) {
+    Vec3D c = proj(Vec3D(i & 1 ? upper[0] : lower[0],
+          i & 2 ? upper[1] : lower[1], i & 4 ? upper[2] : lower[2]));
+    if (c[2] <= near_z) return true;
+    min_x = std::min(min_x, c[0] / c[2]);
+    max_x = std::max(max_x, c[0] / c[2]);
+    min_y = std::min(min_y, c[1] / c[2]);
+    max_y = std::max(max_y, c[1] / c[2]);
+  }
+  return max_x >= -0.5 && min_x < 0.5 && max_y >= -0.5 && min_y < 0.5;
 }
 
-struct Line2D {
-  P a, b;
+PlaneSpan plane_span(const Projection &proj, const PlaneMappingTexture &texture) {
+  Vec3D eu, ev;
+  texture.axes(eu, ev);
+  eu = (1.0 / texture.width) * eu;
+  ev = (1.0 / texture.height) * ev;
+  const Vec3D rel = proj.pos - texture.origin;
+  return PlaneSpan{
+    {{dot(rel, eu), dot(proj.direction, eu), dot(proj.basis[0], eu), dot(proj.basis[1], eu)}},
+    {{dot(rel, ev), dot(proj.direction, ev), dot(proj.basis[0], ev), dot(proj.basis[1], ev)}},
+    &texture};
+}
+
+bool filled(const RenderMode mode) {
+  return mode == RenderMode::FILL || mode == RenderMode::SPANS;
+}
+
+// sets the material of every triangle of one object in one view
+class MaterialOf : public boost::static_visitor<void> {
+ public:
+  MaterialOf(ViewState &state, ProjectedTriangle &pt) : state(state), pt(pt) {}
+  void operator()(const FillfullTexture *texture) const {
+    pt.material = Material::FILL;
+    pt.pixel = texture->pixel;
+  }
+  void operator()(const PlaneMappingTexture *texture) const {
+    pt.material = Material::PLANE;
+    pt.plane = state.planes.size();
+    state.planes.push_back(plane_span(state.proj, *texture));
+  }
+  void operator()(const Texture *texture) const {
+    pt.material = Material::FUNCTION;
+    pt.texture = texture;
+  }
+ private:
+  ViewState &state;
+  ProjectedTriangle &pt;
 };
 
-boost::optional<Line2D> render_impl(
-    const Triangle &tri, const Plane &plane, const std::array<Vec3D, 3> &basis,
-    const Vec3D &camera_pos, const Vec3D &camera_direction) {
-  VP cross_point;
-  for (int i = 0; i < 3; ++i) {
-    Line l(tri[i], tri[(i+1)%3]);
-    Vec3D c = cross(plane, l);
-    if (is_on_segment(c, l)) {
-      double x = dot(c - camera_pos, basis[0]);
-      double z = dot(c - camera_pos, camera_direction);
-      if (z > 0) {
-        cross_point.emplace_back(x/z, z);
+void project(ViewState &state, const std::vector<WorldItem> &items) {
+  const std::size_t h = state.view->height;
+  const bool shaded = filled(state.view->camera.mode);
+  for (const WorldItem &item : items) {
+    if (!may_be_visible(state.proj, item.lower, item.upper)) continue;
+    ProjectedTriangle proto;
+    proto.poly = item.poly;
+    proto.texture = nullptr;
+    proto.plane = 0;
+    if (shaded && item.poly->lighting) proto.material = Material::SHADE;
+    else boost::apply_visitor(MaterialOf(state, proto), item.texture);
+    const Material material = proto.material;
+    const std::vector<Triangle> &triangles = item.poly->triangles;
+    const bool textured = item.poly->uv_texture
+      && item.poly->uvs.size() == triangles.size();
+    Triangle instance_tri;
+    for (std::size_t t = 0; t < triangles.size(); ++t) {
+      const Triangle *tri = &triangles[t];
+      if (item.transform) {
+        instance_tri = applyTransform(*tri, *item.transform);
+        tri = &instance_tri;
+      }
+      ProjectedTriangle pt = proto;
+      pt.uv = textured ? &item.poly->uvs[t] : nullptr;
+      int in_front = 0;
+      for (int k = 0; k < 3; ++k) {
+        pt.v[k] = state.proj((*tri)[k]);
+        in_front += pt.v[k][2] > near_z;
+      }
+      if (in_front == 0) continue;
+      std::size_t first = 0, last = h;
+      if (in_front == 3) {
+        double min_x = 1, max_x = -1, min_y = 1, max_y = -1;
+        for (const Vec3D &v : pt.v) {
+          min_x = std::min(min_x, v[0] / v[2]);
+          max_x = std::max(max_x, v[0] / v[2]);
+          min_y = std::min(min_y, v[1] / v[2]);
+          max_y = std::max(max_y, v[1] / v[2]);
+        }
+        if (max_x < -0.5 || min_x >= 0.5 || max_y < -0.5 || min_y >= 0.5)
+          continue;
+        // one row of slack each way, row_segment makes the exact call
+        first = std::max(0.0, std::ceil((min_y + 0.5) * h) - 1);
+        last = std::min((double)h, std::floor((max_y + 0.5) * h) + 2);
+      }
+      std::uint32_t index = state.triangles.size();
+      state.triangles.push_back(pt);
+      for (std::size_t i = first; i < last; ++i) state.bins[i].push_back(index);
+      if (material == Material::SHADE) {
+        state.lit.push_back(*tri);
+        state.lit_index.push_back(index);
       }
     }
+    if (state.lit.empty()) continue;
+    shade(*item.poly->lighting, state.lit, state.lit_shades);
+    for (std::size_t k = 0; k < state.lit.size(); ++k)
+      state.triangles[state.lit_index[k]].pixel = state.lit_shades[k];
+    state.lit.clear();
+    state.lit_index.clear();
   }
-  std::sort(std::begin(cross_point), std::end(cross_point),
-      [](P l, P r){ return l.real() < r.real(); });
-  if (cross_point.size() == 2) {
-    return (Line2D){cross_point[0], cross_point[1]};
-  }
-  return boost::none;
 }
 
-double linear_interpolation(Line2D line, double x) {
-  double scale = (x - line.a.real()) / (line.b.real() - line.a.real());
-  return scale * (line.b.imag() - line.a.imag()) + line.a.imag();
+// cell endpoints (col, row, col, row) of a projected line, the smaller
+// endpoint first so that shared edges compare equal
+using Edge = std::array<int, 4>;
+
+// a, b in camera space; false if the segment misses the view
+bool edge_cells(Vec3D a, Vec3D b, const std::size_t h, const std::size_t w,
+    Edge &e) {
+  if (a[2] <= near_z && b[2] <= near_z) return false;
+  if (a[2] <= near_z) a = a + ((near_z - a[2]) / (b[2] - a[2])) * (b - a);
+  if (b[2] <= near_z) b = b + ((near_z - b[2]) / (a[2] - b[2])) * (a - b);
+  // column j covers [j, j + 1), row i is centred on i
+  const double x0 = (a[0] / a[2] + 0.5) * w, y0 = (a[1] / a[2] + 0.5) * h + 0.5;
+  const double dx = (b[0] / b[2] + 0.5) * w - x0, dy = (b[1] / b[2] + 0.5) * h + 0.5 - y0;
+  // Liang-Barsky against [0, w) x [0, h)
+  double t0 = 0, t1 = 1;
+  auto clip = [&](const double p, const double q) {
+    if (p == 0) return q >= 0;
+    const double r = q / p;
+    if (p < 0) t0 = std::max(t0, r);
+    else t1 = std::min(t1, r);
+    return t0 <= t1;
+  };
+  const double inside = 1 - 1e-9;
+  if (!clip(-dx, x0) || !clip(dx, w * inside - x0)
+      || !clip(-dy, y0) || !clip(dy, h * inside - y0))
+    return false;
+  auto cell = [](const double v, const std::size_t n) {
+    return std::min<int>(n - 1, std::max(0.0, std::floor(v)));
+  };
+  e = {{cell(x0 + t0 * dx, w), cell(y0 + t0 * dy, h),
+    cell(x0 + t1 * dx, w), cell(y0 + t1 * dy, h)}};
+  if (std::make_pair(e[2], e[3]) < std::make_pair(e[0], e[1]))
+    e = {{e[2], e[3], e[0], e[1]}};
+  return true;
 }
 
-CuiImage Camera::render_line(CuiImage &img, const std::vector<Polygon> &vp, const int i) const {
-  std::vector<double> depth(img.width, 1e+8);
-  double y = (double)i / img.height - 0.5;
-  auto basis = orthonormal_basis(camera_direction);
-  double scale = abs(camera_direction);
-  Plane plane(Triangle(camera_pos,
-        camera_pos + camera_direction + -0.5 * basis[0] + y * basis[1],
-        camera_pos + camera_direction + 0.5 * basis[0] + y * basis[1]));
-  for (const Polygon &poly : vp) {
-    for (const Triangle &tri : poly.triangles) {
-      if (auto opt_segment = render_impl(tri, plane, basis, camera_pos, camera_direction)) {
-        auto segment = *opt_segment;
-        for (int j = std::max(0.0, (segment.a.real() + 0.5) * img.width);
-            j < std::min((double)img.width, (segment.b.real() + 0.5) * img.width); ++j) {
-          double x = (double)j / img.width - 0.5;
-          double dep = linear_interpolation(segment, x);
-          if (dep < depth[j]) {
-            Vec3D p = camera_pos + dep * camera_direction + dep * x * basis[0] + dep * y * basis[1];
-            depth[j] = dep;
-            img.data[i][j] = poly.texture(p);
-            img.visible[i][j] = true;
+// cells are about twice as tall as wide
+char edge_glyph(const int dx, const int dy) {
+  const int ax = std::abs(dx), ay = 2 * std::abs(dy);
+  if (ax == 0 && ay == 0) return '.';
+  return ay * 2 < ax ? '-' : ax * 2 < ay ? '|' : (dx > 0) == (dy > 0) ? '\\' : '/';
+}
+
+// Bresenham
+void draw_line(CuiImage &img, const Viewport &view, const Edge &e) {
+  int x = e[0], y = e[1];
+  const int dx = std::abs(e[2] - x), dy = -std::abs(e[3] - y);
+  const int sx = x < e[2] ? 1 : -1, sy = y < e[3] ? 1 : -1;
+  const Pixel glyph(edge_glyph(e[2] - x, e[3] - y), Color::WHITE, Color::BLACK);
+  int err = dx + dy;
+  while (true) {
+    img.data[view.row + y][view.col + x] = glyph;
+    img.visible[view.row + y][view.col + x] = true;
+    if (x == e[2] && y == e[3]) break;
+    const int e2 = 2 * err;
+    if (e2 >= dy) {
+      err += dy;
+      x += sx;
+    }
+    if (e2 <= dx) {
+      err += dx;
+      y += sy;
+    }
+  }
+}
+
+// WIREFRAME and BOUNDS share the culling of project but stop at lines
+void preview(CuiImage &img, const ViewState &state,
+    const std::vector<WorldItem> &items) {
+  const std::size_t h = state.view->height, w = state.view->width;
+  // triangles are cut into jobs so one big mesh still spreads over workers
+  constexpr std::size_t job_size = 4096;
+  struct Job {
+    const WorldItem *item;
+    std::size_t first, last;
+  };
+  std::vector<Job> jobs;
+  for (const WorldItem &item : items) {
+    if (!may_be_visible(state.proj, item.lower, item.upper)) continue;
+    if (state.view->camera.mode == RenderMode::BOUNDS) {
+      jobs.push_back(Job{&item, 0, 0});
+      continue;
+    }
+    for (std::size_t t = 0; t < item.poly->triangles.size(); t += job_size)
+      jobs.push_back(Job{&item, t, std::min(t + job_size, item.poly->triangles.size())});
+  }
+  const std::size_t th = worker_count();
+  std::vector<std::vector<Edge>> edges(th);
+  // edges spanning at most two neighbouring cells, the bulk of a dense
+  // mesh, go straight to a per worker grid instead of being sorted
+  std::vector<std::vector<char>> cells(th);
+  auto add = [&](const Edge &e, const std::size_t t) {
+    if (std::abs(e[2] - e[0]) > 1 || std::abs(e[3] - e[1]) > 1) {
+      edges[t].push_back(e);
+      return;
+    }
+    const char ch = edge_glyph(e[2] - e[0], e[3] - e[1]);
+    cells[t][e[1] * w + e[0]] = ch;
+    cells[t][e[3] * w + e[2]] = ch;
+  };
+  parallel_interleave(jobs.size(), th, [&](std::size_t k, std::size_t t) {
+        if (cells[t].empty()) cells[t].assign(h * w, 0);
+        const WorldItem &item = *jobs[k].item;
+        Edge e;
+        if (state.view->camera.mode == RenderMode::BOUNDS) {
+          std::array<Vec3D, 8> c;
+          for (int v = 0; v < 8; ++v)
+            c[v] = state.proj(Vec3D(v & 1 ? item.upper[0] : item.lower[0],
+                  v & 2 ? item.upper[1] : item.lower[1],
+                  v & 4 ? item.upper[2] : item.lower[2]));
+          for (int v = 0; v < 8; ++v)
+            for (int a = 1; a < 8; a <<= 1)
+              if (!(v & a) && edge_cells(c[v], c[v | a], h, w, e)) add(e, t);
+          return;
+        }
+        for (std::size_t i = jobs[k].first; i < jobs[k].last; ++i) {
+          const Triangle &src = item.poly->triangles[i];
+          const Triangle tri = item.transform ? applyTransform(src, *item.transform) : src;
+          std::array<Vec3D, 3> v;
+          std::array<int, 6> c;
+          bool inside = true;
+          for (int n = 0; n < 3; ++n) {
+            v[n] = state.proj(tri[n]);
+            if (!inside) continue;
+            const double x = (v[n][0] / v[n][2] + 0.5) * w;
+            const double y = (v[n][1] / v[n][2] + 0.5) * h + 0.5;
+            inside = v[n][2] > near_z && x >= 0 && x < w && y >= 0 && y < h;
+            c[2*n] = x;
+            c[2*n+1] = y;
+          }
+          // the common case needs no clipping
+          for (int n = 0; n < 3; ++n) {
+            const int m = (n + 1) % 3;
+            if (inside) {
+              e = {{c[2*n], c[2*n+1], c[2*m], c[2*m+1]}};
+              if (std::make_pair(e[2], e[3]) < std::make_pair(e[0], e[1]))
+                e = {{e[2], e[3], e[0], e[1]}};
+              add(e, t);
+            } else if (edge_cells(v[n], v[m], h, w, e)) {
+              add(e, t);
+            }
           }
         }
+      });
+  // duplicates across workers are only drawn twice
+  parallel_interleave(th, th, [&](std::size_t t, std::size_t) {
+        std::sort(std::begin(edges[t]), std::end(edges[t]));
+        edges[t].erase(std::unique(std::begin(edges[t]), std::end(edges[t])),
+            std::end(edges[t]));
+      });
+  const Viewport &view = *state.view;
+  for (const auto &grid : cells) {
+    if (grid.empty()) continue;
+    for (std::size_t i = 0; i < h; ++i)
+      for (std::size_t j = 0; j < w; ++j)
+        if (grid[i * w + j]) {
+          img.data[view.row + i][view.col + j] = Pixel(grid[i * w + j],
+              Color::WHITE, Color::BLACK);
+          img.visible[view.row + i][view.col + j] = true;
+        }
+  }
+  for (const auto &found : edges)
+    for (const Edge &edge : found) draw_line(img, view, edge);
+}
+
+struct Segment {
+  double xa, za, xb, zb;
+  TexCoord ta, tb;
+};
+
+// the part of tri on the plane through the camera and screen row y,
+// vertices on the plane included
+bool row_segment(const ProjectedTriangle &tri, const double y, Segment &seg) {
+  std::array<double, 3> f;
+  for (int k = 0; k < 3; ++k) {
+    f[k] = tri.v[k][1] - y * tri.v[k][2];
+    if (std::abs(f[k]) <= 1e-12 * (std::abs(tri.v[k][1]) + std::abs(y * tri.v[k][2])))
+      f[k] = 0;
+  }
+  std::array<Vec3D, 2> p;
+  std::array<TexCoord, 2> t = {};
+  auto lerp = [](const TexCoord &a, const TexCoord &b, const double s) {
+    return TexCoord{a.u + s * (b.u - a.u), a.v + s * (b.v - a.v)};
+  };
+  int n = 0;
+  for (int k = 0; k < 3; ++k) {
+    const Vec3D &a = tri.v[k], &b = tri.v[(k+1)%3];
+    const double fa = f[k], fb = f[(k+1)%3];
+    if (fa == 0) {
+      if (n == 2) return false;
+      if (tri.uv) t[n] = (*tri.uv)[k];
+      p[n++] = a;
+    } else if ((fa < 0 && fb > 0) || (fa > 0 && fb < 0)) {
+      if (n == 2) return false;
+      if (tri.uv) t[n] = lerp((*tri.uv)[k], (*tri.uv)[(k+1)%3], fa / (fa - fb));
+      p[n++] = a + (fa / (fa - fb)) * (b - a);
+    }
+  }
+  if (n != 2) return false;
+  if (p[0][2] <= near_z && p[1][2] <= near_z) return false;
+  for (int k = 0; k < 2; ++k) {
+    Vec3D &q = p[k], &r = p[1-k];
+    if (q[2] > near_z) continue;
+    const double s = (near_z - q[2]) / (r[2] - q[2]);
+    q = q + s * (r - q);
+    t[k] = lerp(t[k], t[1-k], s);
+  }
+  seg = Segment{p[0][0] / p[0][2], p[0][2], p[1][0] / p[1][2], p[1][2], t[0], t[1]};
+  if (seg.xa > seg.xb)
+    seg = Segment{seg.xb, seg.zb, seg.xa, seg.za, seg.tb, seg.ta};
+  return true;
+}
+
+// u / z, v / z and 1 / z are linear in screen x, so they are stepped by
+// additions and divided out only at every span_step-th pixel, with u
+// and v stepped linearly in between
+constexpr int span_step = 8;
+
+template <typename Test>
+void textured_span(std::vector<Pixel> &data, std::vector<bool> &visible,
+    const std::size_t col, const ProjectedTriangle &tri, const Segment &seg,
+    const std::size_t w, int j, const int last, Test test) {
+  const double dx = seg.xb > seg.xa ? 1 / ((seg.xb - seg.xa) * w) : 0;
+  const double wa = 1 / seg.za, wb = 1 / seg.zb;
+  const double dw = (wb - wa) * dx;
+  const double du = (seg.tb.u * wb - seg.ta.u * wa) * dx;
+  const double dv = (seg.tb.v * wb - seg.ta.v * wa) * dx;
+  const double ddep = (seg.zb - seg.za) * dx;
+  const double x0 = ((double)j / w - 0.5 - seg.xa) * w;
+  double iz = wa + x0 * dw, uz = seg.ta.u * wa + x0 * du, vz = seg.ta.v * wa + x0 * dv;
+  double dep = seg.za + x0 * ddep;
+  const UVTexture &texture = tri.poly->uv_texture;
+  TexCoord t = iz > 0 ? TexCoord{uz / iz, vz / iz} : seg.ta;
+  while (j < last) {
+    const int n = std::min(span_step, last - j);
+    iz += n * dw;
+    uz += n * du;
+    vz += n * dv;
+    const TexCoord e = iz > 0 ? TexCoord{uz / iz, vz / iz} : seg.tb;
+    const double su = (e.u - t.u) / n, sv = (e.v - t.v) / n;
+    for (const int end = j + n; j < end; ++j) {
+      if (test(j, dep)) {
+        data[col + j] = texture(t);
+        visible[col + j] = true;
       }
+      dep += ddep;
+      t.u += su;
+      t.v += sv;
     }
+    t = e;
   }
-  return img;
 }
 
-CuiImage Camera::render(CuiImage &img, const std::vector<Polygon> &vp) const {
-  std::vector<std::vector<double>> depth(img.height,
-      std::vector<double>(img.width, 1e+8));
-  size_t th = std::thread::hardware_concurrency();
-  if (th == 1) {
-    for (int i = 0; i < img.height; ++i) {
-      render_line(img, vp, i);
+double slope(const Segment &seg) {
+  return seg.xb > seg.xa ? (seg.zb - seg.za) / (seg.xb - seg.xa) : 0;
+}
+
+template <typename Test, typename Sample>
+void span(std::vector<Pixel> &data, std::vector<bool> &visible,
+    const std::size_t col, const Segment &seg, const std::size_t w,
+    const int first, const int last, Test test, Sample sample) {
+  const double s = slope(seg);
+  for (int j = first; j < last; ++j) {
+    double x = (double)j / w - 0.5;
+    double dep = seg.za + (x - seg.xa) * s;
+    if (test(j, dep)) {
+      data[col + j] = sample(x, dep);
+      visible[col + j] = true;
     }
-  } else {
-    std::vector<std::future<void>> vf;
-    for (size_t t = 0; t < th; ++t) {
-      vf.push_back(std::async(std::launch::async, [=](CuiImage &img, const std::vector<Polygon> &vp, const size_t t) {
-            for (int i = t; i < img.height; i += th) {
-              render_line(img, vp, i);
-            }
-          }, std::ref(img), std::cref(vp), t));
+  }
+}
+
+// cells [first, last) of the row at y covered by seg; test(j, dep) says
+// whether cell j is drawn
+template <typename Test>
+void draw_segment(std::vector<Pixel> &data, std::vector<bool> &visible,
+    const ViewState &state, const ProjectedTriangle &tri, const Segment &seg,
+    const double y, const int first, const int last, Test test) {
+  const std::size_t col = state.view->col, w = state.view->width;
+  if (tri.uv && tri.material != Material::SHADE) {
+    textured_span(data, visible, col, tri, seg, w, first, last, test);
+    return;
+  }
+  switch (tri.material) {
+   case Material::SHADE: {
+    const Pixel pixel = tri.pixel;
+    span(data, visible, col, seg, w, first, last, test,
+        [pixel](double, double) { return pixel; });
+    break;
+   }
+   case Material::FILL: {
+    const Pixel pixel = tri.pixel;
+    span(data, visible, col, seg, w, first, last, test,
+        [pixel](double, double) { return pixel; });
+    break;
+   }
+   case Material::PLANE: {
+    const PlaneSpan &p = state.planes[tri.plane];
+    const double cu = p.u[1] + y * p.u[3], cv = p.v[1] + y * p.v[3];
+    span(data, visible, col, seg, w, first, last, test,
+        [&](double x, double dep) {
+          return (*p.texture)(TexCoord{p.u[0] + dep * (cu + x * p.u[2]),
+              p.v[0] + dep * (cv + x * p.v[2])});
+        });
+    break;
+   }
+   default:
+    span(data, visible, col, seg, w, first, last, test,
+        [&](double x, double dep) {
+          return (*tri.texture)(state.proj.world(x, y, dep));
+        });
+  }
+}
+
+// one row of the span buffer: cells [first, last) show segment seg
+struct Span {
+  int first, last;
+  std::uint32_t seg;
+};
+
+struct SpanSegment {
+  Segment seg;
+  double slope;
+  std::uint32_t triangle;
+};
+
+struct RowScratch {
+  std::vector<double> depth;
+  std::vector<SpanSegment> segments;
+  std::vector<Span> spans, next;
+};
+
+// Span buffer: every row keeps the visible parts of its segments as
+// sorted, disjoint spans. A new segment is split against the spans it
+// overlaps where the two depth lines cross, and cells are shaded once
+// at the end.
+void render_row_spans(CuiImage &img, const ViewState &state, const std::size_t i,
+    RowScratch &scratch) {
+  const Viewport &view = *state.view;
+  const std::size_t w = view.width;
+  const double y = (double)i / view.height - 0.5;
+  auto &segments = scratch.segments;
+  auto &spans = scratch.spans;
+  auto &next = scratch.next;
+  segments.clear();
+  spans.clear();
+  // same expression as span, so both modes agree on every cell
+  auto depth_at = [&](const std::uint32_t k, const int j) {
+    const SpanSegment &s = segments[k];
+    return s.seg.za + ((double)j / w - 0.5 - s.seg.xa) * s.slope;
+  };
+  auto emit = [&](const std::uint32_t k, const int first, const int last) {
+    if (first >= last) return;
+    if (!next.empty() && next.back().seg == k && next.back().last == first)
+      next.back().last = last;
+    else
+      next.push_back(Span{first, last, k});
+  };
+  for (std::uint32_t index : state.bins[i]) {
+    Segment seg;
+    if (!row_segment(state.triangles[index], y, seg)) continue;
+    const int first = std::max(0.0, (seg.xa + 0.5) * w);
+    const int last = std::ceil(std::min((double)w, (seg.xb + 0.5) * w));
+    if (first >= last) continue;
+    const std::uint32_t k = segments.size();
+    segments.push_back(SpanSegment{seg, slope(seg), index});
+    // only the spans overlapping [first, last) are rebuilt
+    auto begin = std::lower_bound(std::begin(spans), std::end(spans), first,
+        [](const Span &s, const int j) { return s.last <= j; });
+    auto end = std::lower_bound(begin, std::end(spans), last,
+        [](const Span &s, const int j) { return s.first < j; });
+    next.clear();
+    int cur = first;
+    for (auto it = begin; it != end; ++it) {
+      const Span s = *it;
+      emit(k, cur, s.first);
+      emit(s.seg, s.first, cur);
+      const int lo = std::max(cur, s.first), hi = std::min(last, s.last);
+      // the depth difference is linear, so the new segment wins on one side
+      // of a single crossing; ties keep the older segment as the z-buffer does
+      auto wins = [&](const int j) { return depth_at(k, j) < depth_at(s.seg, j); };
+      const bool w0 = wins(lo);
+      if (w0 == wins(hi - 1)) {
+        emit(w0 ? k : s.seg, lo, hi);
+      } else {
+        const SpanSegment &a = segments[k], &b = segments[s.seg];
+        const double da = (a.slope - b.slope) / w;
+        const double d0 = (a.seg.za - (0.5 + a.seg.xa) * a.slope)
+          - (b.seg.za - (0.5 + b.seg.xa) * b.slope);
+        int c = lo + 1;
+        if (da != 0) c = std::min<double>(hi - 1, std::max<double>(lo + 1, std::ceil(-d0 / da)));
+        while (c > lo + 1 && wins(c - 1) != w0) --c;
+        while (c < hi - 1 && wins(c) == w0) ++c;
+        emit(w0 ? k : s.seg, lo, c);
+        emit(w0 ? s.seg : k, c, hi);
+      }
+      emit(s.seg, hi, s.last);
+      cur = hi;
     }
-    for (auto && f : vf) f.get();
+    emit(k, cur, last);
+    const std::size_t at = begin - std::begin(spans), n = end - begin;
+    const std::size_t m = std::min(n, next.size());
+    std::copy(std::begin(next), std::begin(next) + m, begin);
+    if (next.size() > n)
+      spans.insert(std::begin(spans) + at + n, std::begin(next) + n, std::end(next));
+    else
+      spans.erase(std::begin(spans) + at + m, std::begin(spans) + at + n);
+  }
+  auto &depth = scratch.depth;
+  depth.assign(w, 1e+8);
+  auto &data = img.data[view.row + i];
+  auto &visible = img.visible[view.row + i];
+  for (const Span &s : spans) {
+    const SpanSegment &seg = segments[s.seg];
+    draw_segment(data, visible, state, state.triangles[seg.triangle], seg.seg,
+        y, s.first, s.last, [&depth](const int j, const double dep) {
+          depth[j] = dep;
+          return true;
+        });
+  }
+}
+
+void render_row(CuiImage &img, const ViewState &state, const std::size_t i,
+    RowScratch &scratch) {
+  if (state.view->camera.mode == RenderMode::SPANS) {
+    render_row_spans(img, state, i, scratch);
+    return;
+  }
+  const Viewport &view = *state.view;
+  const std::size_t w = view.width;
+  const double y = (double)i / view.height - 0.5;
+  auto &depth = scratch.depth;
+  depth.assign(w, 1e+8);
+  auto &data = img.data[view.row + i];
+  auto &visible = img.visible[view.row + i];
+  for (std::uint32_t index : state.bins[i]) {
+    const ProjectedTriangle &tri = state.triangles[index];
+    Segment seg;
+    if (!row_segment(tri, y, seg)) continue;
+    const int first = std::max(0.0, (seg.xa + 0.5) * w);
+    const int last = std::ceil(std::min((double)w, (seg.xb + 0.5) * w));
+    draw_segment(data, visible, state, tri, seg, y, first, last,
+        [&depth](const int j, const double dep) {
+          if (!(dep < depth[j])) return false;
+          depth[j] = dep;
+          return true;
+        });
+  }
+}
+
+CuiImage render_views(CuiImage &img, const std::vector<Viewport> &views,
+    const std::vector<const Polygon *> &vp,
+    const std::vector<const InstancedPolygon *> &vi, DepthBuffer *out,
+    const TextureRef *texture) {
+  std::vector<WorldItem> items = gather(vp, vi, texture);
+  std::vector<ViewState> states;
+  for (const Viewport &view : views) {
+    if (view.row + view.height > img.height || view.col + view.width > img.width)
+      continue;
+    // lines cross rows, so previews are drawn here one view at a time
+    if (!filled(view.camera.mode)) preview(img, ViewState(view), items);
+    else states.emplace_back(view);
+  }
+  parallel_interleave(states.size(), worker_count(),
+      [&](std::size_t k, std::size_t) { project(states[k], items); });
+  // one job per image row: viewports side by side share the packed
+  // visible bits of that row
+  std::vector<std::vector<std::uint32_t>> rows(img.height);
+  for (std::uint32_t k = 0; k < states.size(); ++k)
+    for (std::size_t i = 0; i < states[k].view->height; ++i)
+      rows[states[k].view->row + i].push_back(k);
+  const std::size_t th = worker_count();
+  std::vector<RowScratch> scratch(th);
+  if (out) {
+    out->height = img.height;
+    out->width = img.width;
+    out->depth.assign(img.height * img.width, 1e+8);
   }
+  parallel_interleave(img.height, th, [&](std::size_t r, std::size_t t) {
+        for (std::uint32_t k : rows[r]) {
+          render_row(img, states[k], r - states[k].view->row, scratch[t]);
+          if (out)
+            std::copy(std::begin(scratch[t].depth), std::end(scratch[t].depth),
+                std::begin(out->depth) + r * img.width + states[k].view->col);
+        }
+      });
   return img;
 }
 
+
+} // namespace
+
+Ray Camera::ray(const double x, const double y) const {
+  auto basis = orthonormal_basis(camera_direction);
+  double scale = dot(camera_direction, camera_direction);
+  return Ray(camera_pos, camera_direction + (x * scale) * basis[0] + y * basis[1]);
+}
+
+bool Camera::may_see(const Vec3D &lower, const Vec3D &upper) const {
+  return may_be_visible(Projection(*this), lower, upper);
+}
+
+CuiImage Camera::render(CuiImage &img, const std::vector<Polygon> &vp) const {
+  std::vector<const Polygon *> ptrs;
+  for (const Polygon &poly : vp) ptrs.push_back(&poly);
+  return render(img, ptrs);
+}
+
+CuiImage Camera::render(CuiImage &img, const std::vector<const Polygon *> &vp) const {
+  return cui3d::render(img, {Viewport{*this, 0, 0, img.height, img.width}}, vp);
+}
+
+CuiImage Camera::render(CuiImage &img, const std::vector<const Polygon *> &vp,
+    DepthBuffer &depth) const {
+  return cui3d::render(img, {Viewport{*this, 0, 0, img.height, img.width}},
+      vp, {}, &depth);
+}
+
+CuiImage Camera::render_textured(CuiImage &img,
+    const std::vector<const Polygon *> &vp, const TextureRef &texture) const {
+  return render_views(img, {Viewport{*this, 0, 0, img.height, img.width}},
+      vp, {}, nullptr, &texture);
+}
+
+CuiImage Camera::render(CuiImage &img,
+    const std::vector<InstancedPolygon> &vi) const {
+  std::vector<const InstancedPolygon *> ptrs;
+  for (const InstancedPolygon &ip : vi) ptrs.push_back(&ip);
+  return cui3d::render(img, {Viewport{*this, 0, 0, img.height, img.width}},
+      {}, ptrs);
+}
+
+CuiImage render(CuiImage &img, const std::vector<Viewport> &views,
+    const std::vector<Polygon> &vp) {
+  std::vector<const Polygon *> ptrs;
+  for (const Polygon &poly : vp) ptrs.push_back(&poly);
+  return render(img, views, ptrs);
+}
+
+CuiImage render(CuiImage &img, const std::vector<Viewport> &views,
+    const std::vector<const Polygon *> &vp) {
+  return render(img, views, vp, {});
+}
+
+CuiImage render(CuiImage &img, const std::vector<Viewport> &views,
+    const std::vector<const Polygon *> &vp,
+    const std::vector<const InstancedPolygon *> &vi, DepthBuffer *out) {
+  return render_views(img, views, vp, vi, out, nullptr);
+}
+
 } // namespace cui3d
@@ -0,0 +1,176 @@
+#include "recorder.hpp"
+#include <cstring>
+#include <thread>
+
+namespace cui3d {
+
+namespace {
+
+constexpr char recording_magic[8] = {'C', 'U', 'I', '3', 'D', 'R', 'E', 'C'};
+constexpr std::size_t frame_header_size = 8 + 2 + 2 + 1 + 4;
+constexpr std::uint8_t cleared = 0xff;
+
+template <typename T>
+void put(std::string &buf, const T value) {
+  buf.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+T get(const char *p) {
+  T value;
+  std::memcpy(&value, p, sizeof(T));
+  return value;
+}
+
+} // namespace
+
+status_t FrameRecorder::open(const std::string &path) {
+  ofs.open(path, std::ios::binary | std::ios::trunc);
+  if (!ofs) return status_t::IO_ERROR;
+  ofs.write(recording_magic, sizeof(recording_magic));
+  std::uint32_t version = recording_version;
+  ofs.write(reinterpret_cast<const char *>(&version), sizeof(version));
+  frames = 0;
+  last = CuiImage();
+  start = std::chrono::steady_clock::now();
+  return ofs ? status_t::SUCCESS : status_t::IO_ERROR;
+}
+
+void FrameRecorder::record(const CuiImage &next) {
+  record(next, diff(last, next));
+}
+
+void FrameRecorder::record(const CuiImage &next, const std::chrono::nanoseconds ts) {
+  write(next, diff(last, next), ts);
+}
+
+void FrameRecorder::record(const CuiImage &next, const std::vector<CellRun> &runs) {
+  write(next, runs, std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start));
+}
+
+void FrameRecorder::write(const CuiImage &next, const std::vector<CellRun> &runs,
+    const std::chrono::nanoseconds ts) {
+  if (!ofs.is_open()) return;
+  const bool keyframe = frames % keyframe_interval == 0
+    || next.height != last.height || next.width != last.width;
+  std::vector<CellRun> full;
+  if (keyframe) full = diff(CuiImage(), next);
+  const std::vector<CellRun> &out = keyframe ? full : runs;
+
+  buffer.clear();
+  put<std::uint32_t>(buffer, 0);
+  put<std::uint64_t>(buffer, ts.count());
+  put<std::uint16_t>(buffer, next.height);
+  put<std::uint16_t>(buffer, next.width);
+  put<std::uint8_t>(buffer, keyframe);
+  put<std::uint32_t>(buffer, out.size());
+  for (const CellRun &run : out) {
+    put<std::uint16_t>(buffer, run.row);
+    put<std::uint16_t>(buffer, run.col);
+    put<std::uint16_t>(buffer, run.pixels.size());
+    for (std::size_t k = 0; k < run.pixels.size(); ++k) {
+      const Pixel &p = run.pixels[k];
+      put<char>(buffer, run.visible[k] ? p.ch : ' ');
+      put<std::uint8_t>(buffer, run.visible[k]
+          ? static_cast<int>(p.foreground_color) * 8
+            + static_cast<int>(p.background_color)
+          : cleared);
+    }
+  }
+  std::uint32_t size = buffer.size() - sizeof(std::uint32_t);
+  std::memcpy(&buffer[0], &size, sizeof(size));
+  ofs.write(buffer.data(), buffer.size());
+  last = next;
+  ++frames;
+}
+
+status_t FrameRecorder::close() {
+  ofs.close();
+  return ofs ? status_t::SUCCESS : status_t::IO_ERROR;
+}
+
+status_t FramePlayer::open(const std::string &path) {
+  index.clear();
+  has_current = false;
+  status_t st = file.open(path);
+  if (st != status_t::SUCCESS) return st;
+  const char *data = file.data();
+  const std::size_t size = file.size();
+  std::size_t offset = sizeof(recording_magic) + sizeof(std::uint32_t);
+  if (size < offset
+      || std::memcmp(data, recording_magic, sizeof(recording_magic)) != 0
+      || get<std::uint32_t>(data + 8) != recording_version)
+    return status_t::PARSE_ERROR;
+  // only the frame headers are touched here, runs are skipped by size
+  while (offset + sizeof(std::uint32_t) <= size) {
+    std::size_t body = get<std::uint32_t>(data + offset);
+    offset += sizeof(std::uint32_t);
+    if (body < frame_header_size || offset + body > size)
+      return status_t::PARSE_ERROR;
+    const char *p = data + offset;
+    Entry e;
+    e.timestamp = get<std::uint64_t>(p);
+    e.height = get<std::uint16_t>(p + 8);
+    e.width = get<std::uint16_t>(p + 10);
+    e.keyframe = get<std::uint8_t>(p + 12);
+    e.run_count = get<std::uint32_t>(p + 13);
+    e.offset = offset + frame_header_size;
+    e.end = offset + body;
+    if (index.empty() && !e.keyframe) return status_t::PARSE_ERROR;
+    index.push_back(e);
+    offset += body;
+  }
+  return status_t::SUCCESS;
+}
+
+void FramePlayer::apply_frame(const Entry &e) {
+  if (e.keyframe) current = CuiImage(e.height, e.width);
+  const char *p = file.data() + e.offset;
+  const char *end = file.data() + e.end;
+  // a run count that does not fit the frame drops what is past the end
+  for (std::size_t r = 0; r < e.run_count && end - p >= 6; ++r) {
+    std::size_t row = get<std::uint16_t>(p);
+    std::size_t col = get<std::uint16_t>(p + 2);
+    std::size_t len = get<std::uint16_t>(p + 4);
+    p += 6;
+    if ((std::size_t)(end - p) < 2 * len) return;
+    for (std::size_t k = 0; k < len; ++k, p += 2) {
+      if (row >= current.height || col + k >= current.width) continue;
+      std::uint8_t attr = p[1];
+      if (attr == cleared) {
+        current.visible[row][col + k] = false;
+      } else {
+        current.data[row][col + k] = Pixel(p[0],
+            static_cast<Color>(attr / 8 % 8), static_cast<Color>(attr % 8));
+        current.visible[row][col + k] = true;
+      }
+    }
+  }
+}
+
+const CuiImage &FramePlayer::frame(const std::size_t i) {
+  if (i >= index.size()) return none;
+  std::size_t key = i;
+  while (!index[key].keyframe) --key;
+  std::size_t from = key;
+  if (has_current && current_index <= i && current_index >= key)
+    from = current_index + 1;
+  for (std::size_t k = from; k <= i; ++k) apply_frame(index[k]);
+  current_index = i;
+  has_current = true;
+  return current;
+}
+
+void FramePlayer::play(Screen &scr, const double speed) {
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < index.size(); ++i) {
+    if (speed > 0)
+      std::this_thread::sleep_until(start + std::chrono::nanoseconds(
+            (std::int64_t)(index[i].timestamp / speed)));
+    scr.draw(frame(i));
+    scr.render();
+  }
+}
+
+} // namespace cui3d
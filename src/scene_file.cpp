@@ -0,0 +1,229 @@
+#include "scene_file.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include "parallel.hpp"
+
+namespace cui3d {
+
+namespace {
+
+constexpr char scene_magic[8] = {'C', 'U', 'I', '3', 'D', 'S', 'C', 'N'};
+
+std::uint64_t align8(const std::uint64_t offset) {
+  return (offset + 7) & ~std::uint64_t(7);
+}
+
+void pad(std::ofstream &ofs) {
+  static const char zero[8] = {};
+  ofs.write(zero, align8(ofs.tellp()) - ofs.tellp());
+}
+
+template <typename T>
+void write_array(std::ofstream &ofs, const T *data, const std::size_t count) {
+  ofs.write(reinterpret_cast<const char *>(data), sizeof(T) * count);
+  pad(ofs);
+}
+
+} // namespace
+
+void SceneWriter::add(const Mesh &mesh, const Transform3D &trans) {
+  meshes.push_back(mesh);
+  transforms.push_back(trans);
+}
+
+status_t SceneWriter::write(const std::string &path, const bool with_bvh) const {
+  SceneHeader header = {};
+  std::memcpy(header.magic, scene_magic, sizeof(scene_magic));
+  header.version = scene_file_version;
+  header.mesh_count = meshes.size();
+
+  std::vector<SceneMesh> records;
+  std::vector<Polygon> polys;
+  for (std::size_t i = 0; i < meshes.size(); ++i) {
+    const Mesh &mesh = meshes[i];
+    SceneMesh rec = {};
+    for (int r = 0; r < 4; ++r)
+      for (int c = 0; c < 4; ++c)
+        rec.transform[r][c] = transforms[i][r][c];
+    for (int a = 0; a < 3; ++a) {
+      rec.lower[a] = std::numeric_limits<double>::infinity();
+      rec.upper[a] = -std::numeric_limits<double>::infinity();
+    }
+    for (const Vec3D &v : mesh.vertices) {
+      Vec3D w = applyTransform(v, transforms[i]);
+      for (int a = 0; a < 3; ++a) {
+        rec.lower[a] = std::min(rec.lower[a], w[a]);
+        rec.upper[a] = std::max(rec.upper[a], w[a]);
+      }
+    }
+    rec.first_vertex = header.vertex_count;
+    rec.vertex_count = mesh.vertices.size();
+    rec.first_face = header.face_count;
+    rec.face_count = mesh.faces.size();
+    header.vertex_count += rec.vertex_count;
+    header.face_count += rec.face_count;
+    records.push_back(rec);
+    if (with_bvh) polys.push_back(applyTransform(to_polygon(mesh), transforms[i]));
+  }
+  BVH bvh;
+  if (with_bvh) bvh = BVH(polys);
+  header.node_count = bvh.get_node_count();
+  header.bvh_triangle_count = bvh.get_triangle_count();
+
+  header.mesh_offset = align8(sizeof(SceneHeader));
+  header.vertex_offset = align8(header.mesh_offset
+      + sizeof(SceneMesh) * header.mesh_count);
+  header.face_offset = align8(header.vertex_offset
+      + sizeof(double) * 3 * header.vertex_count);
+  header.node_offset = align8(header.face_offset
+      + sizeof(std::uint32_t) * 3 * header.face_count);
+  header.bvh_triangle_offset = align8(header.node_offset
+      + sizeof(BVHNode) * header.node_count);
+
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  if (!ofs) return status_t::IO_ERROR;
+  write_array(ofs, &header, 1);
+  write_array(ofs, records.data(), records.size());
+  for (const Mesh &mesh : meshes)
+    for (const Vec3D &v : mesh.vertices) {
+      double xyz[3] = {v[0], v[1], v[2]};
+      ofs.write(reinterpret_cast<const char *>(xyz), sizeof(xyz));
+    }
+  pad(ofs);
+  for (const Mesh &mesh : meshes)
+    ofs.write(reinterpret_cast<const char *>(mesh.faces.data()),
+        sizeof(Mesh::Face) * mesh.faces.size());
+  pad(ofs);
+  write_array(ofs, bvh.get_nodes(), bvh.get_node_count());
+  write_array(ofs, bvh.get_triangles(), bvh.get_triangle_count());
+  return ofs ? status_t::SUCCESS : status_t::IO_ERROR;
+}
+
+status_t SceneFile::open(const std::string &path) {
+  header = nullptr;
+  status_t st = file.open(path);
+  if (st != status_t::SUCCESS) return st;
+  const std::uint64_t size = file.size();
+  if (size < sizeof(SceneHeader)) return status_t::PARSE_ERROR;
+  auto h = reinterpret_cast<const SceneHeader *>(file.data());
+  if (std::memcmp(h->magic, scene_magic, sizeof(scene_magic)) != 0
+      || h->version != scene_file_version)
+    return status_t::PARSE_ERROR;
+  auto fits = [size](std::uint64_t offset, std::uint64_t count, std::uint64_t elem) {
+    return offset % 8 == 0 && offset <= size && count <= (size - offset) / elem;
+  };
+  if (!fits(h->mesh_offset, h->mesh_count, sizeof(SceneMesh))
+      || !fits(h->vertex_offset, h->vertex_count, sizeof(double) * 3)
+      || !fits(h->face_offset, h->face_count, sizeof(std::uint32_t) * 3)
+      || !fits(h->node_offset, h->node_count, sizeof(BVHNode))
+      || !fits(h->bvh_triangle_offset, h->bvh_triangle_count, sizeof(BVHTriangle)))
+    return status_t::PARSE_ERROR;
+  const char *base = file.data();
+  meshes = reinterpret_cast<const SceneMesh *>(base + h->mesh_offset);
+  vertices = reinterpret_cast<const double (*)[3]>(base + h->vertex_offset);
+  faces = reinterpret_cast<const std::uint32_t (*)[3]>(base + h->face_offset);
+  nodes = reinterpret_cast<const BVHNode *>(base + h->node_offset);
+  bvh_triangles = reinterpret_cast<const BVHTriangle *>(base + h->bvh_triangle_offset);
+  for (std::size_t i = 0; i < h->mesh_count; ++i) {
+    const SceneMesh &m = meshes[i];
+    if (m.first_vertex > h->vertex_count || m.vertex_count > h->vertex_count - m.first_vertex
+        || m.first_face > h->face_count || m.face_count > h->face_count - m.first_face)
+      return status_t::PARSE_ERROR;
+  }
+  header = h;
+  return status_t::SUCCESS;
+}
+
+status_t SceneFile::verify() const {
+  if (!header) return status_t::UNKNOWN_ERROR;
+  for (std::size_t i = 0; i < header->mesh_count; ++i) {
+    const SceneMesh &m = meshes[i];
+    for (std::uint64_t f = m.first_face; f < m.first_face + m.face_count; ++f)
+      if (!valid_face(m, faces[f])) return status_t::PARSE_ERROR;
+  }
+  return valid_bvh() ? status_t::SUCCESS : status_t::PARSE_ERROR;
+}
+
+// traverse() trusts the tree: children come after their parent, so
+// there are no cycles, and no walk goes deeper than its stack
+bool SceneFile::valid_bvh() const {
+  const SceneHeader &h = *header;
+  const std::uint64_t n = h.node_count;
+  std::vector<std::uint8_t> depth(n, 0);
+  for (std::uint64_t i = 0; i < n; ++i) {
+    const BVHNode &node = nodes[i];
+    if (node.count) {
+      if ((std::uint64_t)node.offset + node.count > h.bvh_triangle_count) return false;
+      continue;
+    }
+    const std::uint64_t left = i + 1, right = node.offset;
+    if (left >= n || right <= left || right >= n
+        || depth[i] + 2u > bvh_max_depth)
+      return false;
+    depth[left] = std::max<std::uint8_t>(depth[left], depth[i] + 1);
+    depth[right] = std::max<std::uint8_t>(depth[right], depth[i] + 1);
+  }
+  for (std::uint64_t i = 0; i < h.bvh_triangle_count; ++i) {
+    const BVHTriangle &tri = bvh_triangles[i];
+    if (tri.polygon_id >= h.mesh_count
+        || tri.triangle_id >= meshes[tri.polygon_id].face_count)
+      return false;
+  }
+  return true;
+}
+
+Transform3D SceneFile::transform(const std::size_t index) const {
+  Transform3D res;
+  for (int r = 0; r < 4; ++r)
+    for (int c = 0; c < 4; ++c)
+      res[r][c] = meshes[index].transform[r][c];
+  return res;
+}
+
+Polygon SceneFile::polygon(const std::size_t index,
+    const std::size_t workers) const {
+  const SceneMesh &m = meshes[index];
+  const Transform3D trans = transform(index);
+  std::vector<Vec3D> world(m.vertex_count);
+  for (std::size_t i = 0; i < m.vertex_count; ++i) {
+    const double *v = vertices[m.first_vertex + i];
+    world[i] = applyTransform(Vec3D(v[0], v[1], v[2]), trans);
+  }
+  Polygon res;
+  res.triangles.resize(m.face_count);
+  std::atomic<bool> damaged(false);
+  parallel_for(m.face_count, workers,
+      [&](std::size_t first, std::size_t last, std::size_t) {
+        for (std::size_t i = first; i < last; ++i) {
+          const std::uint32_t *f = faces[m.first_face + i];
+          if (valid_face(m, f))
+            res.triangles[i] = Triangle(world[f[0]], world[f[1]], world[f[2]]);
+          else
+            damaged = true;
+        }
+      });
+  if (damaged) {
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < m.face_count; ++i)
+      if (valid_face(m, faces[m.first_face + i]))
+        res.triangles[n++] = res.triangles[i];
+    res.triangles.resize(n);
+  }
+  return res;
+}
+
+std::vector<Polygon> SceneFile::polygons() const {
+  std::vector<Polygon> res;
+  for (std::size_t i = 0; i < mesh_count(); ++i)
+    res.push_back(polygon(i));
+  return res;
+}
+
+BVH SceneFile::bvh() const {
+  if (!has_bvh() || !valid_bvh()) return BVH();
+  return BVH(nodes, header->node_count, bvh_triangles, header->bvh_triangle_count);
+}
+
+} // namespace cui3d
@@ -1,13 +1,23 @@
 #include "texture.hpp"
+#include <cmath>
 
 namespace cui3d {
 
-Texture defaultTexture =
-  [](const Vec3D &) { return Pixel('|', Color::WHITE, Color::BLACK); };
+Texture defaultTexture = FillfullTexture(Pixel('|', Color::WHITE, Color::BLACK));
 
-Pixel PlaneMappingTexture::operator()(const Vec3D &vec) {
+void PlaneMappingTexture::axes(Vec3D &eu, Vec3D &ev) const {
+  Vec3D normal(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi),
+      std::cos(theta));
+  auto basis = orthonormal_basis(normal);
+  eu = std::cos(rot) * basis[0] + std::sin(rot) * basis[1];
+  ev = std::cos(rot) * basis[1] - std::sin(rot) * basis[0];
+}
+
+TexCoord PlaneMappingTexture::map(const Vec3D &vec) const {
+  Vec3D eu, ev;
+  axes(eu, ev);
   Vec3D origined_vec = vec - origin;
-  return Pixel('@', Color::RED, Color::WHITE);
+  return TexCoord{dot(origined_vec, eu) / width, dot(origined_vec, ev) / height};
 }
 
 } // namespace cui3d
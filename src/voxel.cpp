@@ -0,0 +1,166 @@
+#include "voxel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "parallel.hpp"
+
+namespace cui3d {
+
+VoxelGrid::VoxelGrid(const std::size_t nx, const std::size_t ny,
+    const std::size_t nz, const Vec3D &origin, const double voxel_size)
+  : nx(nx), ny(ny), nz(nz),
+    bnx((nx + brick - 1) / brick), bny((ny + brick - 1) / brick),
+    bnz((nz + brick - 1) / brick), origin(origin), voxel_size(voxel_size),
+    cells(nx * ny * nz, 0), bricks(bnx * bny * bnz, 0) {}
+
+VoxelGrid VoxelGrid::from_voxels(const std::vector<Voxel> &voxels,
+    const double voxel_size, const Vec3D &lattice_origin) {
+  if (voxels.empty()) return VoxelGrid(0, 0, 0, lattice_origin, voxel_size);
+  std::array<int, 3> lower = {{voxels[0].x, voxels[0].y, voxels[0].z}};
+  std::array<int, 3> upper = lower;
+  for (const Voxel &v : voxels) {
+    std::array<int, 3> p = {{v.x, v.y, v.z}};
+    for (int a = 0; a < 3; ++a) {
+      lower[a] = std::min(lower[a], p[a]);
+      upper[a] = std::max(upper[a], p[a]);
+    }
+  }
+  VoxelGrid res(upper[0] - lower[0] + 1, upper[1] - lower[1] + 1,
+      upper[2] - lower[2] + 1,
+      lattice_origin + voxel_size * Vec3D(lower[0], lower[1], lower[2]),
+      voxel_size);
+  for (const Voxel &v : voxels)
+    res.set(v.x - lower[0], v.y - lower[1], v.z - lower[2], v.value);
+  return res;
+}
+
+void VoxelGrid::set(const std::size_t x, const std::size_t y,
+    const std::size_t z, const std::uint8_t value) {
+  std::uint8_t &cell = cells[(z * ny + y) * nx + x];
+  std::uint16_t &count = bricks[(z / brick * bny + y / brick) * bnx + x / brick];
+  count += (value != 0) - (cell != 0);
+  cell = value;
+}
+
+namespace {
+
+constexpr double inf = std::numeric_limits<double>::infinity();
+
+// Amanatides-Woo traversal in grid units, leaving bricks without any
+// voxel in one jump
+class Marcher {
+ public:
+  Marcher(const VoxelGrid &grid) : grid(grid),
+    size{{(long)grid.get_nx(), (long)grid.get_ny(), (long)grid.get_nz()}} {}
+  bool operator()(const Ray &ray, std::uint8_t &value, int &axis);
+ private:
+  // puts the walk at ray parameter t, which lies on plane index plane of
+  // axis unless axis < 0; with resume set no axis may step backwards,
+  // which rounding could do where the ray crosses an edge, and a cell
+  // outside the grid is left there for the caller to end the walk
+  void start(const double t, const int axis, const long plane, const bool resume);
+  const VoxelGrid &grid;
+  std::array<long, 3> size;
+  std::array<double, 3> o, d, t_max, t_delta;
+  std::array<long, 3> cell;
+  std::array<int, 3> step;
+};
+
+void Marcher::start(const double t, const int axis, const long plane,
+    const bool resume) {
+  for (int a = 0; a < 3; ++a) {
+    if (a == axis) {
+      cell[a] = step[a] > 0 ? plane : plane - 1;
+    } else {
+      long c = std::floor(o[a] + t * d[a]);
+      if (!resume) c = std::max(0L, std::min(size[a] - 1, c));
+      else c = step[a] > 0 ? std::max(c, cell[a])
+        : step[a] < 0 ? std::min(c, cell[a]) : c;
+      cell[a] = c;
+    }
+    t_max[a] = step[a] == 0 ? inf
+      : (cell[a] + (step[a] > 0) - o[a]) / d[a];
+  }
+}
+
+bool Marcher::operator()(const Ray &ray, std::uint8_t &value, int &axis) {
+  const double s = grid.get_voxel_size();
+  double t_enter = 0, t_exit = inf;
+  axis = -1;
+  for (int a = 0; a < 3; ++a) {
+    o[a] = (ray.origin[a] - grid.get_origin()[a]) / s;
+    d[a] = ray.direction[a] / s;
+    step[a] = d[a] > 0 ? 1 : d[a] < 0 ? -1 : 0;
+    t_delta[a] = step[a] ? std::abs(1 / d[a]) : inf;
+    if (step[a] == 0) {
+      if (o[a] < 0 || o[a] >= size[a]) return false;
+      continue;
+    }
+    double lo = (0 - o[a]) / d[a], hi = (size[a] - o[a]) / d[a];
+    if (lo > hi) std::swap(lo, hi);
+    if (lo > t_enter) {
+      t_enter = lo;
+      axis = a;
+    }
+    t_exit = std::min(t_exit, hi);
+  }
+  if (t_enter >= t_exit) return false;
+  start(t_enter, axis, axis < 0 ? 0 : step[axis] > 0 ? 0 : size[axis], false);
+  const long b = VoxelGrid::brick;
+  while (true) {
+    for (int a = 0; a < 3; ++a)
+      if (cell[a] < 0 || cell[a] >= size[a]) return false;
+    if (grid.brick_count(cell[0] / b, cell[1] / b, cell[2] / b) == 0) {
+      // the nearest far face of the brick
+      double t = inf;
+      int next = -1;
+      long plane = 0;
+      for (int a = 0; a < 3; ++a) {
+        if (step[a] == 0) continue;
+        long p = step[a] > 0 ? (cell[a] / b + 1) * b : cell[a] / b * b;
+        double ta = (p - o[a]) / d[a];
+        if (ta < t) {
+          t = ta;
+          next = a;
+          plane = p;
+        }
+      }
+      // the brick may reach past a side the ray has already left by
+      if (t >= t_exit) return false;
+      axis = next;
+      start(t, axis, plane, true);
+      continue;
+    }
+    value = grid.get(cell[0], cell[1], cell[2]);
+    if (value) {
+      if (axis < 0) axis = 2;
+      return true;
+    }
+    int a = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2)
+      : (t_max[1] < t_max[2] ? 1 : 2);
+    cell[a] += step[a];
+    t_max[a] += t_delta[a];
+    axis = a;
+  }
+}
+
+} // namespace
+
+CuiImage Camera::render(CuiImage &img, const VoxelGrid &grid) const {
+  const Pixel fallback('#', Color::WHITE, Color::BLACK);
+  parallel_interleave(img.height, worker_count(), [&](std::size_t i, std::size_t) {
+        Marcher march(grid);
+        const double y = (double)i / img.height - 0.5;
+        for (std::size_t j = 0; j < img.width; ++j) {
+          std::uint8_t value;
+          int axis;
+          if (!march(ray((j + 0.5) / img.width - 0.5, y), value, axis)) continue;
+          img.data[i][j] = value < grid.palette.size()
+            ? grid.palette[value][axis] : fallback;
+          img.visible[i][j] = true;
+        }
+      });
+  return img;
+}
+
+} // namespace cui3d
@@ -0,0 +1,70 @@
+#include "winch.hpp"
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+namespace cui3d {
+
+namespace {
+
+constexpr int max_fds = 16;
+// descriptor + 1, 0 for a free slot
+std::atomic<int> fds[max_fds];
+std::atomic<int> in_handler(0);
+std::atomic<unsigned long> resizes(0);
+std::mutex mtx;
+int subscriptions = 0;
+struct sigaction saved;
+
+void on_winch(int sig) {
+  int saved_errno = errno;
+  ++resizes;
+  ++in_handler;
+  for (auto &slot : fds) {
+    const int fd = slot.load() - 1;
+    char c = 0;
+    if (fd >= 0 && write(fd, &c, 1) < 0) {}
+  }
+  --in_handler;
+  if (!(saved.sa_flags & SA_SIGINFO) && saved.sa_handler != SIG_DFL
+      && saved.sa_handler != SIG_IGN)
+    saved.sa_handler(sig);
+  errno = saved_errno;
+}
+
+} // namespace
+
+WinchSubscription::WinchSubscription(const int fd) : slot(-1) {
+  std::lock_guard<std::mutex> lk(mtx);
+  if (fd >= 0)
+    for (int k = 0; k < max_fds && slot < 0; ++k) {
+      int expected = 0;
+      if (fds[k].compare_exchange_strong(expected, fd + 1)) slot = k;
+    }
+  if (subscriptions++ > 0) return;
+  struct sigaction sa = {};
+  sa.sa_handler = on_winch;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGWINCH, &sa, &saved);
+}
+
+unsigned long WinchSubscription::generation() {
+  return resizes;
+}
+
+WinchSubscription::~WinchSubscription() {
+  std::lock_guard<std::mutex> lk(mtx);
+  if (slot >= 0) {
+    fds[slot] = 0;
+    // the caller may close fd once no handler can still be writing to it
+    while (in_handler) std::this_thread::yield();
+  }
+  if (--subscriptions > 0) return;
+  sigaction(SIGWINCH, &saved, nullptr);
+}
+
+} // namespace cui3d
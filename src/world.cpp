@@ -0,0 +1,160 @@
+#include "world.hpp"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace cui3d {
+
+namespace {
+
+double box_distance(const Vec3D &p, const Vec3D &lower, const Vec3D &upper) {
+  Vec3D nearest;
+  for (int a = 0; a < 3; ++a)
+    nearest[a] = std::min(std::max(p[a], lower[a]), upper[a]);
+  return abs(nearest - p);
+}
+
+} // namespace
+
+ChunkedWorld::ChunkedWorld(const std::size_t budget, const double chunk_size,
+    const double view_distance)
+  : budget(budget), chunk_size(chunk_size), view_distance(view_distance),
+    resident_bytes(0), frame(0), loads(0), evictions(0), misses(0),
+    oversized(0), stopped(false) {}
+
+ChunkedWorld::~ChunkedWorld() {
+  close();
+}
+
+status_t ChunkedWorld::open(const std::string &path) {
+  close();
+  status_t st = file.open(path);
+  if (st != status_t::SUCCESS) return st;
+  for (std::size_t i = 0; i < file.mesh_count(); ++i) {
+    const SceneMesh &m = file.mesh(i);
+    if (m.face_count == 0) continue;
+    Key key(std::floor((m.lower[0] + m.upper[0]) / 2 / chunk_size),
+        std::floor((m.lower[1] + m.upper[1]) / 2 / chunk_size),
+        std::floor((m.lower[2] + m.upper[2]) / 2 / chunk_size));
+    auto ins = chunks.emplace(key, Chunk());
+    Chunk &c = ins.first->second;
+    for (int a = 0; a < 3; ++a) {
+      c.lower[a] = ins.second ? m.lower[a] : std::min(c.lower[a], m.lower[a]);
+      c.upper[a] = ins.second ? m.upper[a] : std::max(c.upper[a], m.upper[a]);
+    }
+    if (ins.second) {
+      c.bytes = 0;
+      c.used = 0;
+      c.lru = std::end(lru);
+    }
+    c.meshes.push_back(i);
+    c.bytes += sizeof(Polygon) + m.face_count * sizeof(Triangle);
+  }
+  oversized = 0;
+  for (const auto &kv : chunks) oversized += kv.second.bytes > budget;
+  stopped = false;
+  loader = std::thread(&ChunkedWorld::load, this);
+  return status_t::SUCCESS;
+}
+
+void ChunkedWorld::close() {
+  {
+    std::lock_guard<std::mutex> lk(mtx);
+    stopped = true;
+  }
+  cv.notify_all();
+  if (loader.joinable()) loader.join();
+  chunks.clear();
+  lru.clear();
+  queue.clear();
+  resident_bytes = 0;
+  oversized = 0;
+  file = SceneFile();
+}
+
+CuiImage ChunkedWorld::render(const Camera &cam, CuiImage &img) {
+  std::vector<std::pair<double, Chunk *>> wanted;
+  for (auto &kv : chunks) {
+    Chunk &c = kv.second;
+    // evicting everything would not make room for it
+    if (c.bytes > budget) continue;
+    double d = box_distance(cam.camera_pos, c.lower, c.upper);
+    if (d <= view_distance && cam.may_see(c.lower, c.upper))
+      wanted.emplace_back(d, &c);
+  }
+  std::sort(std::begin(wanted), std::end(wanted),
+      [](const std::pair<double, Chunk *> &a, const std::pair<double, Chunk *> &b) {
+        return a.first < b.first;
+      });
+  // the polygons stay alive for this frame even if the loader evicts them
+  std::vector<std::shared_ptr<const std::vector<Polygon>>> held;
+  {
+    std::lock_guard<std::mutex> lk(mtx);
+    ++frame;
+    queue.clear();
+    for (auto &w : wanted) {
+      Chunk &c = *w.second;
+      c.used = frame;
+      if (c.polygons) {
+        held.push_back(c.polygons);
+        lru.splice(std::begin(lru), lru, c.lru);
+      } else {
+        ++misses;
+        queue.push_back(&c);
+      }
+    }
+    std::reverse(std::begin(queue), std::end(queue));
+  }
+  cv.notify_one();
+  std::vector<const Polygon *> vp;
+  for (const auto &polys : held)
+    for (const Polygon &p : *polys) vp.push_back(&p);
+  return cam.render(img, vp);
+}
+
+WorldStats ChunkedWorld::stats() const {
+  std::lock_guard<std::mutex> lk(mtx);
+  return WorldStats{chunks.size(), lru.size(), resident_bytes, queue.size(),
+    loads, evictions, misses, oversized};
+}
+
+// chunks drawn by the latest frame are never dropped for another one
+bool ChunkedWorld::make_room(const std::size_t bytes) {
+  while (resident_bytes + bytes > budget && !lru.empty()
+      && lru.back()->used != frame)
+    evict(*lru.back());
+  return resident_bytes + bytes <= budget;
+}
+
+void ChunkedWorld::evict(Chunk &c) {
+  resident_bytes -= c.bytes;
+  c.polygons.reset();
+  lru.erase(c.lru);
+  c.lru = std::end(lru);
+  ++evictions;
+}
+
+void ChunkedWorld::load() {
+  std::unique_lock<std::mutex> lk(mtx);
+  while (true) {
+    cv.wait(lk, [this] { return stopped || !queue.empty(); });
+    if (stopped) return;
+    Chunk &c = *queue.back();
+    queue.pop_back();
+    if (c.polygons || !make_room(c.bytes)) continue;
+    lk.unlock();
+    // one worker, the render threads keep the cores
+    auto polys = std::make_shared<std::vector<Polygon>>();
+    for (std::size_t m : c.meshes) polys->push_back(file.polygon(m, 1));
+    lk.lock();
+    if (stopped) return;
+    // only this thread adds bytes, the room made above is still there
+    c.polygons = polys;
+    lru.push_front(&c);
+    c.lru = std::begin(lru);
+    resident_bytes += c.bytes;
+    ++loads;
+  }
+}
+
+} // namespace cui3d
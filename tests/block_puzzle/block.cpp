@@ -112,22 +112,28 @@ bool operator!=(const Block &lhs, const Block &rhs) {
   return !(lhs == rhs);
 }
 
-cui3d::Polygon to_polygon(const Block &blk, const cui3d::Texture &texture) {
-  using std::begin;
-  using std::end;
-  cui3d::Polygon poly;
-  poly.texture = texture;
+cui3d::InstancedPolygon to_polygon(const Block &blk, const cui3d::Texture &texture) {
+  static const auto cube = std::make_shared<const cui3d::Polygon>(
+      cui3d::make_cuboid(cui3d::Vec3D(0, 0, 0), cui3d::Vec3D(0.1, 0.1, 0.1)));
+  cui3d::InstancedPolygon poly;
+  poly.mesh = cube;
   for (I3d c : blk.cubes) {
     c += blk.offset;
-    auto cube = cui3d::make_cuboid(
-        0.1*cui3d::Vec3D(c[0], c[1], c[2]),
-        0.1*cui3d::Vec3D(c[0]+1, c[1]+1, c[2]+1));
-    poly.triangles.insert(end(poly.triangles),
-        begin(cube.triangles), end(cube.triangles));
+    poly.instances.push_back(cui3d::Instance{
+        cui3d::translateXYZ(0.1*c[0], 0.1*c[1], 0.1*c[2]), texture});
   }
   return poly;
 }
 
+std::vector<cui3d::Voxel> to_voxels(const Block &blk, const std::uint8_t value) {
+  std::vector<cui3d::Voxel> res;
+  for (I3d c : blk.cubes) {
+    c += blk.offset;
+    res.push_back(cui3d::Voxel{c[0], c[1], c[2], value});
+  }
+  return res;
+}
+
 I3d gravity_point(const std::vector<I3d> &i3dv) {
   I3d sum = {0, 0, 0};
   for (I3d i : i3dv) sum += i;
@@ -3,6 +3,8 @@
 #include <vector>
 #include <texture.hpp>
 #include <polygon.hpp>
+#include <instancing.hpp>
+#include <voxel.hpp>
 
 using I3d = std::array<int, 3>;
 
@@ -28,5 +30,6 @@ Block merge(const Block &, const Block &);
 bool is_subset(const Block &lhs, const Block &rhs);
 bool operator==(const Block &, const Block &);
 bool operator!=(const Block &, const Block &);
-cui3d::Polygon to_polygon(const Block &, const cui3d::Texture &);
+cui3d::InstancedPolygon to_polygon(const Block &, const cui3d::Texture &);
+std::vector<cui3d::Voxel> to_voxels(const Block &, const std::uint8_t value);
 std::vector<Block> divide_block(const Block &, const int);
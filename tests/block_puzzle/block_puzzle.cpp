@@ -1,20 +1,26 @@
 #include <cassert>
-#include <ctime>
 #include <iostream>
 #include <tuple>
-#include <sys/time.h>
-#include <boost/timer/timer.hpp>
 #include <curses.h>
 #include <cui3d.hpp>
+#include <event_loop.hpp>
+#include <frame_cache.hpp>
 #include "block.hpp"
 
 class Game {
  public:
   Game(const Block &goal, int n)
-    : n(n), now_selected(0), goal(goal), blocks(divide_block(goal, n)) {
+    : n(n), now_selected(0), goal(goal), blocks(divide_block(goal, n)),
+      voxel_mode(false), scene_version(0) {
     assert(n > 0);
   }
   void select_next() { now_selected = (now_selected + 1) % n; }
+  void toggle_voxel_mode() {
+    voxel_mode = !voxel_mode;
+    ++scene_version;
+  }
+  // bumped on every change to what draw shows
+  std::uint64_t version() const { return scene_version; }
   bool move_cmd(char command) {
     if (command == '\n') {
       select_next();
@@ -54,6 +60,7 @@ class Game {
     }
     if (is_ok(nx)) {
       now_selected_block() = nx;
+      ++scene_version;
       return true;
     }
     return false;
@@ -67,7 +74,23 @@ class Game {
   const Block &now_selected_block() const { return blocks[now_selected]; }
   cui3d::CuiImage draw(const cui3d::Camera & cam,
       cui3d::CuiImage &img) const {
-    std::vector<cui3d::Polygon> polys;
+    if (voxel_mode) {
+      std::vector<cui3d::Voxel> voxels;
+      for (int k = 0; k < n; ++k) {
+        auto v = to_voxels(blocks[k], k + 1);
+        voxels.insert(std::end(voxels), std::begin(v), std::end(v));
+      }
+      auto grid = cui3d::VoxelGrid::from_voxels(voxels, 0.1);
+      grid.palette.resize(n + 1);
+      for (int k = 1; k <= n; ++k) {
+        auto color = static_cast<cui3d::Color>(k);
+        grid.palette[k] = {{cui3d::Pixel(' ', cui3d::Color::BLACK, color),
+          cui3d::Pixel('.', cui3d::Color::BLACK, color),
+          cui3d::Pixel(':', cui3d::Color::BLACK, color)}};
+      }
+      return cam.render(img, grid);
+    }
+    std::vector<cui3d::InstancedPolygon> polys;
     int counter = 1;
     for (auto &blk : blocks) {
       polys.emplace_back(to_polygon(blk,
@@ -84,6 +107,8 @@ class Game {
   int now_selected;
   Block goal;
   std::vector<Block> blocks;
+  bool voxel_mode;
+  std::uint64_t scene_version;
   Block &now_selected_block() { return blocks[now_selected]; }
   bool is_ok(const Block &blk) {
     for (int i = 0; i < n; ++i) {
@@ -126,34 +151,60 @@ int main() {
   cui3d::Camera c;
   c.camera_pos = cui3d::Vec3D(0.0, 0.0, -2.0);
   c.camera_direction = cui3d::Vec3D(0.0, 0.0, 2.0);
-  scr.draw(draw(g, c, h, w));
-  scr.render();
-  noecho();
-  while (true) {
-    int com = getch();
-    if (com < 0) break;
-    switch (com) {
+  cui3d::FrameCache cache;
+  cui3d::EventLoop loop;
+  loop.run([&](const std::vector<cui3d::InputEvent> &events) {
+    bool changed = false;
+    for (const auto &e : events) {
       using namespace cui3d;
-     case 'y':
-      c.camera_pos = applyTransform(c.camera_pos, rotateX(pi/6.0));
-      c.camera_direction = applyTransform(c.camera_direction, rotateX(pi/6.0));
-      break;
-     case 'u':
-      c.camera_pos = applyTransform(c.camera_pos, rotateY(pi/6.0));
-      c.camera_direction = applyTransform(c.camera_direction, rotateY(pi/6.0));
-      break;
-     case 'i':
-      c.camera_pos = applyTransform(c.camera_pos, rotateZ(pi/6.0));
-      c.camera_direction = applyTransform(c.camera_direction, rotateZ(pi/6.0));
-      break;
-     default:
-      if(!g.move_cmd(com)) beep();
+      if (e.type == InputEvent::Type::CLOSE) {
+        loop.stop();
+        break;
+      }
+      if (e.type == InputEvent::Type::RESIZE) {
+        scr.poll_resize();
+        std::tie(h, w) = fix_size(scr.get_height(), scr.get_width(), 2.5);
+        changed = true;
+        continue;
+      }
+      if (e.type != InputEvent::Type::KEY) continue;
+      switch (e.key) {
+       case 'y':
+        c.camera_pos = applyTransform(c.camera_pos, rotateX(pi/6.0));
+        c.camera_direction = applyTransform(c.camera_direction, rotateX(pi/6.0));
+        changed = true;
+        break;
+       case 'u':
+        c.camera_pos = applyTransform(c.camera_pos, rotateY(pi/6.0));
+        c.camera_direction = applyTransform(c.camera_direction, rotateY(pi/6.0));
+        changed = true;
+        break;
+       case 'i':
+        c.camera_pos = applyTransform(c.camera_pos, rotateZ(pi/6.0));
+        c.camera_direction = applyTransform(c.camera_direction, rotateZ(pi/6.0));
+        changed = true;
+        break;
+       case 'v':
+        g.toggle_voxel_mode();
+        changed = true;
+        break;
+       case 'm':
+        c.mode = c.mode == RenderMode::FILL ? RenderMode::SPANS
+          : c.mode == RenderMode::SPANS ? RenderMode::WIREFRAME
+          : c.mode == RenderMode::WIREFRAME ? RenderMode::BOUNDS : RenderMode::FILL;
+        changed = true;
+        break;
+       default:
+        if (g.move_cmd(e.key)) changed = true;
+        else beep();
+      }
     }
-    scr.draw(draw(g, c, h, w));
+    return changed;
+  }, [&] {
+    scr.draw(cache.get(cui3d::frame_key(g.version(), c, h, w),
+          [&] { return draw(g, c, h, w); }));
     scr.render();
-    timespec ts = {0, (long)100000000};
-    nanosleep(&ts, nullptr);
-  }
+  });
   return 0;
 }
 
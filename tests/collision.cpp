@@ -0,0 +1,136 @@
+#include <cui3d.hpp>
+#include <collision.hpp>
+#include <iostream>
+#include <random>
+#include <string>
+
+// checks the narrow phase on contact cases, then moves objects around a
+// CollisionWorld and compares its pairs with every triangle against
+// every other
+namespace {
+
+using namespace cui3d;
+using Pairs = std::vector<std::pair<CollisionWorld::Id, CollisionWorld::Id>>;
+
+std::size_t failures = 0;
+
+void expect(const std::string &name, const bool got, const bool want) {
+  if (got == want) return;
+  std::cout << name << ": got " << got << ", want " << want << std::endl;
+  ++failures;
+}
+
+Polygon cube(const Vec3D &lower, const double size) {
+  return make_cuboid(lower, lower + Vec3D(size, size, size));
+}
+
+bool brute(const Polygon &a, const Polygon &b) {
+  for (const Triangle &s : a.triangles)
+    for (const Triangle &t : b.triangles)
+      if (intersect(s, t)) return true;
+  return false;
+}
+
+Pairs brute(const std::vector<Polygon> &objects, const std::vector<bool> &live) {
+  Pairs res;
+  for (std::size_t i = 0; i < objects.size(); ++i)
+    for (std::size_t j = i + 1; j < objects.size(); ++j)
+      if (live[i] && live[j] && brute(objects[i], objects[j]))
+        res.emplace_back(i, j);
+  return res;
+}
+
+void contacts() {
+  const Polygon a = cube(Vec3D(0, 0, 0), 1);
+  expect("overlapping", intersect(a, cube(Vec3D(0.5, 0.5, 0.5), 1)), true);
+  expect("apart", intersect(a, cube(Vec3D(1.01, 0, 0), 1)), false);
+  expect("face contact", intersect(a, cube(Vec3D(1, 0.2, 0.2), 0.5)), true);
+  expect("edge contact", intersect(a, cube(Vec3D(1, 1, 0), 1)), true);
+  expect("vertex contact", intersect(a, cube(Vec3D(1, 1, 1), 1)), true);
+  expect("nested", intersect(a, cube(Vec3D(0.25, 0.25, 0.25), 0.5)), false);
+  const Triangle t(Vec3D(0, 0, 0), Vec3D(1, 0, 0), Vec3D(0, 1, 0));
+  expect("coplanar overlap",
+      intersect(t, Triangle(Vec3D(0.2, 0.2, 0), Vec3D(2, 0.2, 0), Vec3D(0.2, 2, 0))), true);
+  expect("coplanar inside",
+      intersect(t, Triangle(Vec3D(0.1, 0.1, 0), Vec3D(0.3, 0.1, 0), Vec3D(0.1, 0.3, 0))), true);
+  expect("coplanar shared vertex",
+      intersect(t, Triangle(Vec3D(1, 0, 0), Vec3D(2, 0, 0), Vec3D(2, 1, 0))), true);
+  expect("coplanar apart",
+      intersect(t, Triangle(Vec3D(0.6, 0.6, 0), Vec3D(2, 0.6, 0), Vec3D(0.6, 2, 0))), false);
+  expect("piercing",
+      intersect(t, Triangle(Vec3D(0.2, 0.2, -1), Vec3D(0.2, 0.2, 1), Vec3D(3, 3, 0))), true);
+  expect("vertex on face",
+      intersect(t, Triangle(Vec3D(0.2, 0.2, 0), Vec3D(0.2, 0.5, 1), Vec3D(0.5, 0.2, 1))), true);
+  expect("above",
+      intersect(t, Triangle(Vec3D(0.2, 0.2, 0.1), Vec3D(0.2, 0.5, 1), Vec3D(0.5, 0.2, 1))), false);
+}
+
+void world() {
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> pos(0.0, 6.0), vel(-1.0, 1.0), size(0.3, 1.2);
+  const std::size_t n = 60;
+  std::vector<Vec3D> at(n), v(n);
+  std::vector<double> sizes(n);
+  std::vector<Polygon> objects;
+  std::vector<bool> live(n, true);
+  CollisionWorld cw(0.05);
+  for (std::size_t i = 0; i < n; ++i) {
+    at[i] = Vec3D(pos(rng), pos(rng), pos(rng));
+    v[i] = Vec3D(vel(rng), vel(rng), vel(rng));
+    sizes[i] = size(rng);
+    objects.push_back(cube(at[i], sizes[i]));
+    expect("ids in order", cw.add(objects[i]) == i, true);
+  }
+  std::size_t pairs = 0;
+  for (int frame = 0; frame < 40; ++frame) {
+    for (std::size_t i = 0; i < n; ++i) {
+      if (!live[i]) continue;
+      at[i] = at[i] + 0.1 * v[i];
+      objects[i].triangles = cube(at[i], sizes[i]).triangles;
+      cw.update(i, objects[i]);
+    }
+    if (frame == 10) {
+      // freed ids come back for the next objects
+      for (std::size_t i : {5, 17, 33}) {
+        expect("remove", cw.remove(i), true);
+        live[i] = false;
+      }
+      expect("remove twice", cw.remove(17), false);
+      expect("update removed", cw.update(17, objects[17]), false);
+    }
+    if (frame == 20) {
+      for (int k = 0; k < 2; ++k) {
+        const CollisionWorld::Id id = cw.add(objects[0]);
+        expect("id reused", id == 33 || id == 17, true);
+        objects[id].triangles = cube(at[0], sizes[0]).triangles;
+        at[id] = at[0];
+        sizes[id] = sizes[0];
+        live[id] = true;
+      }
+    }
+    const Pairs got = cw.colliding_pairs(), want = brute(objects, live);
+    expect("frame " + std::to_string(frame) + " pairs", got == want, true);
+    pairs += got.size();
+  }
+  // a move out of the grown box reinserts, one inside the margin keeps
+  // the tree as it is
+  const std::size_t before = cw.reinsertions();
+  objects[0].triangles = cube(at[0] + Vec3D(1, 0, 0), sizes[0]).triangles;
+  cw.update(0, objects[0]);
+  expect("large move reinserts", cw.reinsertions() == before + 1, true);
+  objects[0].triangles = cube(at[0] + Vec3D(1.01, 0, 0), sizes[0]).triangles;
+  cw.update(0, objects[0]);
+  expect("small move keeps the leaf", cw.reinsertions() == before + 1, true);
+  expect("after moves", cw.colliding_pairs() == brute(objects, live), true);
+  std::cout << pairs << " colliding pairs over 40 frames, "
+    << cw.reinsertions() << " reinsertions" << std::endl;
+}
+
+} // namespace
+
+int main() {
+  contacts();
+  world();
+  std::cout << failures << " failures" << std::endl;
+  return failures ? 1 : 0;
+}
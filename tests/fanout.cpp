@@ -0,0 +1,33 @@
+#include <cui3d.hpp>
+#include <frame_server.hpp>
+#include <ctime>
+#include <iostream>
+
+// fanout socket_path, then watch with `nc -U socket_path` from any terminal
+int main(int argc, char **argv) {
+  using namespace cui3d;
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " socket_path" << std::endl;
+    return 1;
+  }
+  FrameServer server;
+  if (server.listen(argv[1]) != status_t::SUCCESS) {
+    std::cerr << argv[1] << ": cannot listen" << std::endl;
+    return 1;
+  }
+  Camera c;
+  c.camera_pos = Vec3D(0.0, 0.0, -2.0);
+  c.camera_direction = Vec3D(0.0, 0.0, 2.0);
+  for (int i = 0; ; ++i) {
+    double t = i / 100.0;
+    std::vector<Polygon> p;
+    p.emplace_back(applyTransform(make_cuboid(Vec3D(-0.3, -0.3, -0.3),
+        Vec3D(0.3, 0.3, 0.3)), rotateY(t) * rotateX(t * 0.7)));
+    p[0].texture = PlaneMappingTexture();
+    CuiImage img(24, 60);
+    server.publish(c.render(img, p));
+    timespec ts = {0, (long)(1e+9/30.0)};
+    nanosleep(&ts, nullptr);
+  }
+  return 0;
+}
@@ -0,0 +1,45 @@
+#include <cui3d.hpp>
+#include <governor.hpp>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
+
+// a renderer that always overruns drives the governor to its lowest
+// scale, which must stay in [0.01, 1] whatever min_scale was given
+namespace {
+
+using namespace cui3d;
+
+std::size_t failures = 0;
+
+void lowest(const std::string &name, const double min_scale, const double want) {
+  ResolutionGovernor gov(std::chrono::nanoseconds(1), min_scale, 1);
+  std::size_t h = 0, w = 0;
+  for (int k = 0; k < 5; ++k) {
+    CuiImage img = gov.render(50, 200, [&](std::size_t height, std::size_t width) {
+          h = height;
+          w = width;
+          return CuiImage(height, width);
+        });
+    if (img.height != 50 || img.width != 200) ++failures;
+  }
+  const bool ok = std::abs(gov.get_scale() - want) < 1e-12 && h >= 1 && w >= 1;
+  std::cout << name << ": scale " << gov.get_scale() << ", rendered " << h
+    << "x" << w << (ok ? "" : ", want scale " + std::to_string(want))
+    << std::endl;
+  failures += !ok;
+}
+
+} // namespace
+
+int main() {
+  lowest("default", 0.25, 0.25);
+  lowest("zero", 0.0, 0.01);
+  lowest("negative", -1.0, 0.01);
+  lowest("tiny", 1e-300, 0.01);
+  lowest("nan", std::numeric_limits<double>::quiet_NaN(), 0.01);
+  lowest("one", 1.0, 1.0);
+  lowest("above one", 4.0, 1.0);
+  return failures ? 1 : 0;
+}
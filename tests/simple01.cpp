@@ -1,15 +1,20 @@
 #include <cui3d.hpp>
-#include <ctime>
+#include <batch.hpp>
+#include <compositor.hpp>
+#include <frame_loop.hpp>
+#include <governor.hpp>
+#include <recorder.hpp>
 #include <iostream>
+#include <string>
 #include <tuple>
-#include <sys/time.h>
-#include <boost/timer/timer.hpp>
 
-cui3d::CuiImage draw(int h, int w, double t) {
+cui3d::CuiImage draw(cui3d::CuiImage &img, double t) {
   using namespace cui3d;
   Camera c;
   c.camera_pos = cui3d::Vec3D(0.0, 0.0, -2.0);
   c.camera_direction = cui3d::Vec3D(0.0, 0.0, 2.0);
+  // the boxes overlap a lot, each cell is shaded once
+  c.mode = RenderMode::SPANS;
   std::vector<Polygon> p;
   p.emplace_back(cui3d::make_cuboid(Vec3D(t*1.6-0.8, 0.2, 0.0),
       Vec3D(t*1.6-0.5,0.5, 0.3)));
@@ -22,9 +27,7 @@ cui3d::CuiImage draw(int h, int w, double t) {
   p[0].texture = PlaneMappingTexture();
   p[1].texture = PlaneMappingTexture();
   p[2].texture = PlaneMappingTexture();
-  cui3d::CuiImage img(h, w);
-  img = c.render(img, p);
-  return img;
+  return c.render(img, p);
 }
 
 std::tuple<int, int> fix_size(int h, int w, double ratio = 2.0) {
@@ -32,21 +35,60 @@ std::tuple<int, int> fix_size(int h, int w, double ratio = 2.0) {
   else return std::make_tuple(w/ratio, w);
 }
 
-int main() {
-  cui3d::Screen scr;
-  for (int i = 0; i < 1200; ++i) {
-    double t = i/200.0;
-    boost::timer::cpu_timer tm;
-    int h, w;
-    std::tie(h, w) = fix_size(scr.get_height(), scr.get_width(), 2.5);
-    cui3d::CuiImage img = draw(h, w, t);
-    scr.draw(img);
-    scr.render();
-    double rem = 1e+9/60.0 - tm.elapsed().wall;
-    if (rem > 0) {
-      timespec ts = {0, (long)rem};
-      nanosleep(&ts, nullptr);
+// simple01 [recording]
+// simple01 --batch recording [height width]
+int main(int argc, char **argv) {
+  if (argc > 2 && std::string(argv[1]) == "--batch") {
+    const std::size_t frames = 1200;
+    const std::size_t h = argc > 4 ? std::stoul(argv[3]) : 40;
+    const std::size_t w = argc > 4 ? std::stoul(argv[4]) : 100;
+    cui3d::status_t st = cui3d::render_batch(argv[2], frames, h, w,
+        std::chrono::nanoseconds((long)(1e+9/60.0)),
+        [frames](std::size_t k, cui3d::CuiImage &img) { draw(img, 6.0 * k / frames); });
+    if (st != cui3d::status_t::SUCCESS) {
+      std::cerr << argv[2] << ": failed to write" << std::endl;
+      return 1;
     }
+    return 0;
   }
+  cui3d::FrameStats stats;
+  {
+    cui3d::Screen scr;
+    cui3d::FrameRecorder recorder;
+    if (argc > 1 && recorder.open(argv[1]) == cui3d::status_t::SUCCESS)
+      scr.set_recorder(&recorder);
+    const std::chrono::nanoseconds period((long)(1e+9/60.0));
+    cui3d::ResolutionGovernor governor(period);
+    cui3d::FrameLoop loop(period, std::chrono::milliseconds(10));
+    // static overlay, composited once
+    const std::string title = " simple01 ";
+    cui3d::CuiImage label(1, title.size());
+    for (std::size_t j = 0; j < title.size(); ++j) {
+      label.data[0][j] = cui3d::Pixel(title[j], cui3d::Color::BLACK, cui3d::Color::WHITE);
+      label.visible[0][j] = true;
+    }
+    scr.add_layer(1, title.size(), 1, 0, 1).draw(label);
+    double t = 0, prev_t = 0;
+    loop.run([&](double dt) {
+          prev_t = t;
+          t += dt * 0.3;
+          if (t >= 6.0) loop.stop();
+        }, [&](double alpha) {
+          double shown = prev_t + (t - prev_t) * alpha;
+          int h, w;
+          std::tie(h, w) = fix_size(scr.get_height(), scr.get_width(), 2.5);
+          cui3d::CuiImage img = governor.render(h, w,
+              [shown](std::size_t h, std::size_t w) {
+                cui3d::CuiImage img(h, w);
+                return draw(img, shown);
+              });
+          scr.draw(img);
+          scr.render();
+        });
+    stats = loop.stats();
+  }
+  std::cout << stats.frames << " frames, p50 " << stats.p50.count() / 1e+6
+    << " ms, p99 " << stats.p99.count() / 1e+6 << " ms, missed "
+    << stats.missed << std::endl;
   return 0;
 }
@@ -1,24 +1,24 @@
 #include <cui3d.hpp>
-#include <ctime>
+#include <frame_loop.hpp>
+#include <particles.hpp>
 #include <cmath>
 #include <iostream>
+#include <memory>
+#include <random>
 #include <tuple>
-#include <sys/time.h>
-#include <boost/timer.hpp>
 
-cui3d::CuiImage draw(int h, int w, double t) {
+cui3d::CuiImage draw(int h, int w, double t, cui3d::ParticleSystem &sparks) {
   using namespace cui3d;
   Camera c;
   c.camera_pos = cui3d::Vec3D(0.0, 0.0, -1.0);
   c.camera_direction = cui3d::Vec3D(1.0 * sin(t-0.5), 0.0,
       1.0 * cos(t-0.5));
-  std::vector<Polygon> p;
-  p.emplace_back(cui3d::make_cuboid(Vec3D(-0.1, 0.2, 0.0),
-      Vec3D(0.1, 0.4, 0.2)));
-  p[0].texture = PlaneMappingTexture();
+  Polygon p = cui3d::make_cuboid(Vec3D(-0.1, 0.2, 0.0), Vec3D(0.1, 0.4, 0.2));
+  p.lighting = std::make_shared<Lighting>();
   cui3d::CuiImage img(h, w);
-  img = c.render(img, p);
-  return img;
+  DepthBuffer depth;
+  img = c.render(img, {&p}, depth);
+  return sparks.render(c, img, &depth);
 }
 
 std::tuple<int, int> fix_size(int h, int w, double ratio = 2.0) {
@@ -28,21 +28,27 @@ std::tuple<int, int> fix_size(int h, int w, double ratio = 2.0) {
 
 int main() {
   cui3d::Screen scr;
-  for (int i = 0; i < 200; ++i) {
-    double t = i/200.0;
-    double process_time = 0;
-    boost::timer tm;
-    int h, w;
-    std::tie(h, w) = fix_size(scr.get_height(), scr.get_width(), 2.5);
-    cui3d::CuiImage img = draw(h, w, t);
-    scr.draw(img);
-    scr.render();
-    process_time += tm.elapsed();
-    double rem = 1.0/60 - process_time;
-    if (rem > 0) {
-      timespec ts = {0, (long)(rem * 1000000000)};
-      nanosleep(&ts, nullptr);
-    }
-  }
+  cui3d::FrameLoop loop(std::chrono::nanoseconds((long)(1e+9/60.0)));
+  cui3d::ParticleSystem sparks(20000);
+  sparks.glyphs = {cui3d::Pixel('*', cui3d::Color::YELLOW, cui3d::Color::BLACK),
+    cui3d::Pixel('+', cui3d::Color::RED, cui3d::Color::BLACK),
+    cui3d::Pixel('.', cui3d::Color::RED, cui3d::Color::BLACK)};
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> spread(-0.3, 0.3);
+  int i = 0;
+  loop.run([&](double dt) {
+        if (++i == 200) loop.stop();
+        for (int k = 0; k < 100; ++k)
+          sparks.emit(cui3d::Vec3D(0.0, 0.2, 0.1),
+              cui3d::Vec3D(spread(rng), -0.8 + spread(rng), spread(rng)), 1.0);
+        sparks.update(dt, cui3d::Vec3D(0.0, 1.5, 0.0));
+      }, [&](double) {
+        double t = i/200.0;
+        int h, w;
+        std::tie(h, w) = fix_size(scr.get_height(), scr.get_width(), 2.5);
+        cui3d::CuiImage img = draw(h, w, t, sparks);
+        scr.draw(img);
+        scr.render();
+      });
   return 0;
 }
@@ -0,0 +1,88 @@
+#include <cui3d.hpp>
+#include <iostream>
+#include <random>
+#include <string>
+
+// renders the same scenes with FILL and SPANS and fails unless every
+// cell and every depth agree
+namespace {
+
+using namespace cui3d;
+
+Polygon colored(Polygon &&poly, const char ch, const Color color) {
+  poly.texture = FillfullTexture(Pixel(ch, color, Color::BLACK));
+  return std::move(poly);
+}
+
+std::size_t compare(const std::string &name, const std::vector<Polygon> &scene,
+    Camera cam, const std::size_t h, const std::size_t w) {
+  std::vector<const Polygon *> ptrs;
+  for (const Polygon &poly : scene) ptrs.push_back(&poly);
+  CuiImage fill(h, w), spans(h, w);
+  DepthBuffer fill_depth, spans_depth;
+  cam.mode = RenderMode::FILL;
+  cam.render(fill, ptrs, fill_depth);
+  cam.mode = RenderMode::SPANS;
+  cam.render(spans, ptrs, spans_depth);
+  std::size_t bad = 0, shown = 0;
+  for (std::size_t i = 0; i < h; ++i)
+    for (std::size_t j = 0; j < w; ++j) {
+      shown += fill.visible[i][j];
+      if (fill.visible[i][j] != spans.visible[i][j]
+          || (fill.visible[i][j] && fill.data[i][j] != spans.data[i][j])
+          || fill_depth(i, j) != spans_depth(i, j))
+        ++bad;
+    }
+  std::cout << name << ": " << shown << " cells shown, " << bad << " differ"
+    << std::endl;
+  return bad;
+}
+
+} // namespace
+
+int main() {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> pos(-0.6, 0.6), angle(0.0, 3.2);
+  const Color colors[] = {Color::RED, Color::GREEN, Color::BLUE, Color::YELLOW};
+  Camera cam;
+  cam.camera_pos = Vec3D(0.0, 0.0, -2.0);
+  cam.camera_direction = Vec3D(0.0, 0.0, 2.0);
+  std::size_t bad = 0;
+
+  // heavy overdraw of textured and flat boxes
+  std::vector<Polygon> boxes;
+  for (int k = 0; k < 40; ++k) {
+    Polygon box = applyTransform(make_cuboid(Vec3D(-0.15, -0.15, -0.15),
+          Vec3D(0.15, 0.15, 0.15)), translateXYZ(pos(rng), pos(rng), pos(rng))
+        * rotateY(angle(rng)) * rotateX(angle(rng)));
+    if (k % 2) box.texture = PlaneMappingTexture();
+    else box.texture = FillfullTexture(Pixel('a' + k % 26, colors[k % 4], Color::BLACK));
+    boxes.push_back(std::move(box));
+  }
+  bad += compare("overlapping boxes", boxes, cam, 48, 160);
+  bad += compare("overlapping boxes, odd size", boxes, cam, 17, 33);
+
+  // boxes passing through each other, the visible edge runs mid span
+  std::vector<Polygon> crossing;
+  for (int k = 0; k < 4; ++k)
+    crossing.push_back(colored(applyTransform(make_cuboid(Vec3D(-0.4, -0.1, -0.1),
+              Vec3D(0.4, 0.1, 0.1)), rotateZ(0.8 * k) * rotateY(0.3 * k)),
+          '0' + k, colors[k]));
+  bad += compare("intersecting boxes", crossing, cam, 60, 180);
+
+  // coplanar quads at the same depth: the first drawn must win the tie
+  std::vector<Polygon> coplanar;
+  coplanar.push_back(colored(make_cuboid(Vec3D(-0.4, -0.4, 0.0),
+          Vec3D(0.2, 0.2, 0.0)), '#', Color::RED));
+  coplanar.push_back(colored(make_cuboid(Vec3D(-0.2, -0.2, 0.0),
+          Vec3D(0.4, 0.4, 0.0)), '*', Color::GREEN));
+  coplanar.push_back(colored(make_cuboid(Vec3D(-0.4, -0.4, 0.0),
+          Vec3D(0.2, 0.2, 0.0)), '+', Color::BLUE));
+  bad += compare("coplanar ties", coplanar, cam, 40, 120);
+  Camera tilted = cam;
+  tilted.camera_pos = Vec3D(0.7, 0.4, -1.8);
+  tilted.camera_direction = Vec3D(-0.7, -0.4, 1.8);
+  bad += compare("coplanar ties, tilted", coplanar, tilted, 40, 120);
+  bad += compare("overlapping boxes, tilted", boxes, tilted, 40, 120);
+  return bad ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+#include <cui3d.hpp>
+#include <voxel.hpp>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+
+// marches rays through grids whose sizes are no multiple of the brick and
+// compares every cell with the nearest voxel found by testing them all
+namespace {
+
+using namespace cui3d;
+
+// the value of the nearest filled voxel along the ray, 0 if none
+std::uint8_t brute(const VoxelGrid &grid, const Ray &ray) {
+  double best = std::numeric_limits<double>::infinity();
+  std::uint8_t res = 0;
+  const double s = grid.get_voxel_size();
+  for (std::size_t z = 0; z < grid.get_nz(); ++z)
+    for (std::size_t y = 0; y < grid.get_ny(); ++y)
+      for (std::size_t x = 0; x < grid.get_nx(); ++x) {
+        const std::uint8_t value = grid.get(x, y, z);
+        if (!value) continue;
+        const std::size_t p[] = {x, y, z};
+        double lo = 0, hi = best;
+        for (int a = 0; a < 3 && lo <= hi; ++a) {
+          const double l = grid.get_origin()[a] + s * p[a];
+          if (ray.direction[a] == 0) {
+            if (ray.origin[a] < l || ray.origin[a] >= l + s) hi = -1;
+            continue;
+          }
+          double t0 = (l - ray.origin[a]) / ray.direction[a];
+          double t1 = (l + s - ray.origin[a]) / ray.direction[a];
+          if (t0 > t1) std::swap(t0, t1);
+          lo = std::max(lo, t0);
+          hi = std::min(hi, t1);
+        }
+        if (lo <= hi && lo < best) {
+          best = lo;
+          res = value;
+        }
+      }
+  return res;
+}
+
+std::size_t compare(const std::string &name, const VoxelGrid &grid,
+    const Camera &cam) {
+  const std::size_t h = 40, w = 120;
+  CuiImage img(h, w);
+  cam.render(img, grid);
+  std::size_t bad = 0, shown = 0;
+  for (std::size_t i = 0; i < h; ++i)
+    for (std::size_t j = 0; j < w; ++j) {
+      const std::uint8_t want = brute(grid,
+          cam.ray((j + 0.5) / w - 0.5, (double)i / h - 0.5));
+      shown += img.visible[i][j];
+      if (img.visible[i][j] != (want != 0)
+          || (want && img.data[i][j].ch != grid.palette[want][0].ch))
+        ++bad;
+    }
+  std::cout << name << ": " << shown << " cells shown, " << bad << " differ"
+    << std::endl;
+  return bad;
+}
+
+VoxelGrid palette(VoxelGrid &&grid) {
+  for (char c : std::string(".abcdefgh"))
+    grid.palette.push_back({{Pixel(c, Color::RED, Color::BLACK),
+        Pixel(c, Color::GREEN, Color::BLACK), Pixel(c, Color::BLUE, Color::BLACK)}});
+  return std::move(grid);
+}
+
+} // namespace
+
+int main() {
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<double> unit(-1.0, 1.0);
+  std::size_t bad = 0;
+
+  // a lone voxel in the last brick, rays leaving through the short side
+  VoxelGrid lone = palette(VoxelGrid(8, 3, 8));
+  lone.set(4, 2, 0, 1);
+  for (int k = 0; k < 8; ++k) {
+    Camera cam;
+    cam.camera_pos = Vec3D(4 + 9 * unit(rng), 1.5 + 9 * unit(rng), 4 + 9 * unit(rng));
+    cam.camera_direction = Vec3D(4, 1.5, 4) - cam.camera_pos;
+    bad += compare("lone voxel " + std::to_string(k), lone, cam);
+  }
+
+  // sparse random grids of odd sizes
+  const std::size_t sizes[][3] = {{5, 7, 9}, {13, 2, 6}, {1, 11, 3}};
+  for (const auto &n : sizes) {
+    VoxelGrid grid = palette(VoxelGrid(n[0], n[1], n[2], Vec3D(-1, -2, 0.5), 0.5));
+    std::uniform_int_distribution<std::size_t> x(0, n[0] - 1), y(0, n[1] - 1),
+      z(0, n[2] - 1), value(1, 8);
+    for (int v = 0; v < 6; ++v) grid.set(x(rng), y(rng), z(rng), value(rng));
+    const Vec3D centre = Vec3D(-1, -2, 0.5) + 0.25 * Vec3D(n[0], n[1], n[2]);
+    for (int k = 0; k < 4; ++k) {
+      Camera cam;
+      cam.camera_pos = centre + 8 * Vec3D(unit(rng), unit(rng), unit(rng));
+      cam.camera_direction = centre - cam.camera_pos;
+      bad += compare(std::to_string(n[0]) + "x" + std::to_string(n[1]) + "x"
+          + std::to_string(n[2]) + " view " + std::to_string(k), grid, cam);
+    }
+  }
+  return bad ? 1 : 0;
+}
@@ -0,0 +1,75 @@
+#include <cui3d.hpp>
+#include <frame_loop.hpp>
+#include <mesh.hpp>
+#include <scene_file.hpp>
+#include <world.hpp>
+#include <iostream>
+#include <string>
+#include <tuple>
+
+// a size x size field of pillars, one mesh each
+cui3d::status_t write_city(const std::string &path, const int size) {
+  using namespace cui3d;
+  SceneWriter writer;
+  for (int i = 0; i < size; ++i) {
+    for (int k = 0; k < size; ++k) {
+      Polygon p = make_cuboid(Vec3D(0, 0, 0), Vec3D(0.2, 0.2 + (i * 7 + k * 3) % 5 * 0.1, 0.2));
+      Mesh mesh;
+      for (const Triangle &tri : p.triangles) {
+        for (int v = 0; v < 3; ++v) {
+          mesh.vertices.push_back(tri[v]);
+        }
+        std::uint32_t n = mesh.vertices.size();
+        mesh.faces.push_back(Mesh::Face{{n - 3, n - 2, n - 1}});
+      }
+      writer.add(mesh, translateXYZ(i * 0.5 - size * 0.25, 0.3, k * 0.5));
+    }
+  }
+  return writer.write(path, false);
+}
+
+std::tuple<int, int> fix_size(int h, int w, double ratio = 2.0) {
+  if (w > h * ratio) return std::make_tuple(h, h*ratio);
+  else return std::make_tuple(w/ratio, w);
+}
+
+// world scene-file, the city is written there first
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " scene-file" << std::endl;
+    return 1;
+  }
+  const std::string path = argv[1];
+  if (write_city(path, 200) != cui3d::status_t::SUCCESS) {
+    std::cerr << path << ": failed to write" << std::endl;
+    return 1;
+  }
+  cui3d::WorldStats stats;
+  {
+    cui3d::ChunkedWorld world(1 << 20, 2.0, 6.0);
+    if (world.open(path) != cui3d::status_t::SUCCESS) return 1;
+    cui3d::Screen scr;
+    cui3d::Camera c;
+    cui3d::CuiImage img;
+    c.camera_pos = cui3d::Vec3D(0.0, 0.0, -2.0);
+    c.camera_direction = cui3d::Vec3D(0.0, 0.0, 2.0);
+    cui3d::FrameLoop loop(std::chrono::nanoseconds((long)(1e+9/30.0)));
+    loop.run([&](double dt) {
+          c.camera_pos = c.camera_pos + cui3d::Vec3D(0.0, 0.0, dt * 4.0);
+          if (c.camera_pos[2] > 100.0) loop.stop();
+        }, [&](double) {
+          int h, w;
+          scr.poll_resize();
+          std::tie(h, w) = fix_size(scr.get_height(), scr.get_width(), 2.5);
+          img.resize(h, w);
+          scr.draw(world.render(c, img));
+          scr.render();
+        });
+    stats = world.stats();
+  }
+  std::cout << stats.chunk_count << " chunks, " << stats.resident_chunks
+    << " resident (" << stats.resident_bytes << " bytes), " << stats.loads
+    << " loads, " << stats.evictions << " evictions, " << stats.misses
+    << " misses, " << stats.oversized_chunks << " too large" << std::endl;
+  return 0;
+}
@@ -0,0 +1,37 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <ansi.hpp>
+#include <cui3d.hpp>
+#include <recorder.hpp>
+
+// replay recording [speed], speed 0 plays as fast as possible
+// replay recording --frame N [--text], prints one frame without a screen
+int main(int argc, char **argv) {
+  using namespace cui3d;
+  if (argc < 2 || (argc > 2 && std::strcmp(argv[2], "--frame") == 0 && argc < 4)) {
+    std::cerr << "usage: " << argv[0] << " recording [speed]\n"
+      << "       " << argv[0] << " recording --frame N [--text]" << std::endl;
+    return 1;
+  }
+  FramePlayer player;
+  if (player.open(argv[1]) != status_t::SUCCESS) {
+    std::cerr << argv[1] << ": not a recording" << std::endl;
+    return 1;
+  }
+  if (argc > 2 && std::strcmp(argv[2], "--frame") == 0) {
+    std::size_t i = std::strtoul(argv[3], nullptr, 10);
+    if (i >= player.frame_count()) {
+      std::cerr << argv[1] << ": " << player.frame_count() << " frames" << std::endl;
+      return 1;
+    }
+    CuiImage img = player.frame(i);
+    if (argc > 4 && std::strcmp(argv[4], "--text") == 0) img.view();
+    else std::cout << to_ansi(diff(CuiImage(), img), true) << std::endl;
+    return 0;
+  }
+  double speed = argc > 2 ? std::atof(argv[2]) : 1.0;
+  Screen scr;
+  player.play(scr, speed);
+  return 0;
+}
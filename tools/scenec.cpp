@@ -0,0 +1,40 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mesh.hpp>
+#include <scene_file.hpp>
+
+// scenec [--bvh] output input.obj|input.stl...
+int main(int argc, char **argv) {
+  using namespace cui3d;
+  std::vector<std::string> args(argv + 1, argv + argc);
+  bool with_bvh = false;
+  if (!args.empty() && args.front() == "--bvh") {
+    with_bvh = true;
+    args.erase(args.begin());
+  }
+  if (args.size() < 2) {
+    std::cerr << "usage: " << argv[0]
+      << " [--bvh] output input.obj|input.stl..." << std::endl;
+    return 1;
+  }
+  SceneWriter writer;
+  for (std::size_t i = 1; i < args.size(); ++i) {
+    const std::string &path = args[i];
+    Mesh mesh;
+    bool is_stl = path.size() >= 4
+      && (path.compare(path.size() - 4, 4, ".stl") == 0
+        || path.compare(path.size() - 4, 4, ".STL") == 0);
+    status_t st = is_stl ? load_stl(path, mesh) : load_obj(path, mesh);
+    if (st != status_t::SUCCESS) {
+      std::cerr << path << ": failed to load" << std::endl;
+      return 1;
+    }
+    writer.add(mesh);
+  }
+  if (writer.write(args[0], with_bvh) != status_t::SUCCESS) {
+    std::cerr << args[0] << ": failed to write" << std::endl;
+    return 1;
+  }
+  return 0;
+}